@@ -0,0 +1,887 @@
+// Microbenchmark suite for the banking core. Each benchmark builds its own
+// bank in memory (or in a scratch data directory for the durability
+// benchmarks), times one operation in a loop and reports the result as
+// JSON so runs from different releases can be compared.
+//
+// Build: cmake --preset release && cmake --build --preset release
+// Usage: bank_benchmark [--accounts N,N,...] [--operations N] [--threads N]
+//                       [--filter TEXT] [--output FILE] [--data-dir DIR] [--quick]
+//
+// Account counts default to 1K, 100K and 1M; find_account also runs at 10M
+// (about 3 GB resident). --accounts replaces both lists and --quick keeps
+// to the smaller sizes.
+//
+// JSON goes to stdout (or --output), a one-line summary per result to stderr.
+
+#include "bank_workload.h"
+#include <sstream>
+#include <cstdlib>
+#include <malloc.h>
+
+struct BenchmarkOptions {
+    std::vector<size_t> accountCounts{1000, 100000, 1000000};
+    std::vector<size_t> lookupCounts{10000000};   // further sizes for find_account alone
+    uint64_t operations = 2000000;     // per timed loop, before any cap
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::string filter;                // run only benchmarks whose name contains this
+    std::string outputPath;
+    std::string dataDir;               // scratch directory; a temporary one by default
+};
+
+// One reported result. Parameters and extra metrics are kept in insertion
+// order so the JSON reads the same from run to run.
+struct Measurement {
+    std::string name;
+    std::vector<std::pair<std::string, uint64_t>> parameters;
+    uint64_t operations = 0;
+    double seconds = 0;
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+// Keeps the compiler from discarding a value computed only for timing
+template <typename T>
+inline void keepValue(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// splitmix64: small, fast and good enough to pick accounts at random
+class BenchmarkRandom {
+private:
+    uint64_t state;
+
+public:
+    explicit BenchmarkRandom(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    size_t below(size_t bound) { return static_cast<size_t>(next() % bound); }
+};
+
+template <typename Fn>
+double measureSeconds(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs fn(thread) on threads workers released together and returns the time
+// from the release until the last one finishes
+template <typename Fn>
+double measureThreads(unsigned threads, Fn fn) {
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            fn(t);
+        });
+    }
+    while (ready.load() < threads) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& worker : pool) {
+        worker.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string accountName(size_t i) {
+    return "BM" + std::to_string(i);
+}
+
+static std::vector<std::string> accountNames(size_t count) {
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        names.push_back(accountName(i));
+    }
+    return names;
+}
+
+enum class AccountMix {
+    Savings,
+    Current
+};
+
+static std::unique_ptr<Bank> makeBank(const std::vector<std::string>& names, AccountMix mix,
+                                      Money initialBalance) {
+    auto bank = std::make_unique<Bank>("Benchmark Bank");
+    for (const auto& name : names) {
+        if (mix == AccountMix::Savings) {
+            bank->openSavingsAccount(name, "Holder", initialBalance);
+        } else {
+            bank->openCurrentAccount(name, "Holder", initialBalance);
+        }
+    }
+    return bank;
+}
+
+// Thread counts 1, 2, 4, ... up to and including maxThreads
+static std::vector<unsigned> threadSteps(unsigned maxThreads) {
+    std::vector<unsigned> steps;
+    for (unsigned t = 1; t < maxThreads; t *= 2) {
+        steps.push_back(t);
+    }
+    steps.push_back(maxThreads);
+    return steps;
+}
+
+// Resident set size of this process, from /proc/self/statm
+static uint64_t residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * uint64_t(::sysconf(_SC_PAGESIZE));
+}
+
+// Stand-in for checkWithdrawal as the virtual function it used to be: one
+// indirect call per account through an interface the loop cannot see
+// through, to compare with visitAccount dispatch
+class VirtualWithdrawalRules {
+public:
+    virtual ~VirtualWithdrawalRules() = default;
+    virtual OperationStatus check(const Account& account, Money amount, Money& fee) const = 0;
+};
+
+template <typename T>
+class VirtualWithdrawalRulesFor final : public VirtualWithdrawalRules {
+public:
+    OperationStatus check(const Account& account, Money amount, Money& fee) const override {
+        return static_cast<const T&>(account).checkWithdrawal(amount, fee);
+    }
+};
+
+static void removeDataDirectory(const std::string& dir) {
+    ::unlink((dir + "/bank.wal").c_str());
+    ::unlink((dir + "/bank.snapshot").c_str());
+    ::unlink((dir + "/bank.snapshot.tmp").c_str());
+    ::rmdir(dir.c_str());
+}
+
+class BenchmarkSuite {
+private:
+    BenchmarkOptions options;
+    std::vector<Measurement> results;
+
+    bool selected(const std::string& name) const {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    void record(Measurement measurement) {
+        std::cerr << std::left << std::setw(28) << measurement.name;
+        for (const auto& [key, value] : measurement.parameters) {
+            std::cerr << ' ' << key << '=' << value;
+        }
+        if (measurement.operations > 0) {
+            std::cerr << "  " << std::fixed << std::setprecision(1)
+                      << measurement.seconds * 1e9 / measurement.operations << " ns/op, "
+                      << std::setprecision(0) << measurement.operations / measurement.seconds << " ops/s";
+        }
+        for (const auto& [key, value] : measurement.metrics) {
+            std::cerr << "  " << key << '=' << std::defaultfloat << std::setprecision(6) << value;
+        }
+        std::cerr << std::defaultfloat << std::endl;
+        results.push_back(std::move(measurement));
+    }
+
+    // Timed loop over a single-threaded operation
+    template <typename Fn>
+    void recordLoop(std::string name, std::vector<std::pair<std::string, uint64_t>> parameters,
+                    uint64_t operations, Fn fn) {
+        Measurement measurement;
+        measurement.name = std::move(name);
+        measurement.parameters = std::move(parameters);
+        measurement.operations = operations;
+        measurement.seconds = measureSeconds([&]() {
+            for (uint64_t i = 0; i < operations; ++i) {
+                fn(i);
+            }
+        });
+        record(std::move(measurement));
+    }
+
+    // Random account indexes, drawn before timing starts
+    std::vector<uint32_t> randomIndexes(size_t accounts, uint64_t count, uint64_t seed) const {
+        BenchmarkRandom random(seed);
+        std::vector<uint32_t> indexes(count);
+        for (auto& index : indexes) {
+            index = static_cast<uint32_t>(random.below(accounts));
+        }
+        return indexes;
+    }
+
+    void benchmarkAccountCreation(size_t accounts) {
+        std::vector<std::string> names = accountNames(accounts);
+        Bank bank("Benchmark Bank");
+        recordLoop("account_creation", {{"accounts", accounts}}, accounts, [&](uint64_t i) {
+            bank.openCurrentAccount(names[i], "Holder", Money::fromCents(10000));
+        });
+    }
+
+    // Opens generated savings and current accounts with realistic holder
+    // names and opening balances, reporting the growth in resident memory
+    // per account (accounts, index and opening ledger entries) and the
+    // time taken to tear the bank down again
+    void benchmarkBulkLoad(size_t accounts) {
+        WorkloadSpec spec;
+        spec.savingsAccounts = static_cast<uint32_t>(accounts / 2);
+        spec.currentAccounts = static_cast<uint32_t>(accounts - accounts / 2);
+        std::vector<WorkloadAccount> generated = WorkloadGenerator(spec).generateAccounts();
+        // Hand freed memory back first so earlier benchmarks do not hide
+        // the growth
+        ::malloc_trim(0);
+        uint64_t residentBefore = residentBytes();
+        auto bank = std::make_unique<Bank>("Benchmark Bank");
+        Measurement measurement;
+        measurement.name = "account_bulk_load";
+        measurement.parameters = {{"accounts", accounts}};
+        measurement.operations = accounts;
+        measurement.seconds = measureSeconds([&]() { openWorkloadAccounts(*bank, generated); });
+        uint64_t residentAfter = residentBytes();
+        double releaseSeconds = measureSeconds([&]() { bank.reset(); });
+        measurement.metrics = {
+            {"resident_bytes_per_account", double(residentAfter - residentBefore) / double(accounts)},
+            {"release_seconds", releaseSeconds}};
+        record(std::move(measurement));
+    }
+
+    void benchmarkFindAccount(size_t accounts) {
+        std::vector<std::string> names = accountNames(accounts);
+        auto bank = makeBank(names, AccountMix::Current, Money());
+        std::vector<uint32_t> indexes = randomIndexes(accounts, options.operations, 1);
+        recordLoop("find_account", {{"accounts", accounts}}, options.operations, [&](uint64_t i) {
+            keepValue(bank->findAccount(names[indexes[i]]));
+        });
+
+        // Only the names probed, so the largest sizes still fit in memory
+        std::vector<std::string> missing;
+        missing.reserve(indexes.size());
+        for (uint32_t index : indexes) {
+            missing.push_back(accountName(accounts + index));
+        }
+        recordLoop("find_account_missing", {{"accounts", accounts}}, options.operations,
+                   [&](uint64_t i) {
+            keepValue(bank->findAccount(missing[i]));
+        });
+    }
+
+    void benchmarkDepositWithdraw(size_t accounts) {
+        std::vector<std::string> names = accountNames(accounts);
+        std::vector<uint32_t> indexes = randomIndexes(accounts, options.operations, 2);
+        {
+            auto bank = makeBank(names, AccountMix::Savings, Money::fromCents(100000));
+            recordLoop("deposit", {{"accounts", accounts}}, options.operations, [&](uint64_t i) {
+                keepValue(bank->deposit(names[indexes[i]], Money::fromCents(100)));
+            });
+        }
+        {
+            // The same with latency metrics recorded, to track their overhead
+            auto bank = makeBank(names, AccountMix::Savings, Money::fromCents(100000));
+            BankMetrics metrics;
+            bank->setMetrics(&metrics);
+            recordLoop("deposit_metrics", {{"accounts", accounts}}, options.operations, [&](uint64_t i) {
+                keepValue(bank->deposit(names[indexes[i]], Money::fromCents(100)));
+            });
+        }
+        {
+            // Enough that no withdrawal ever reaches the minimum balance
+            Money opening = Money::fromCents(int64_t(100) * int64_t(options.operations) + 1000000);
+            auto bank = makeBank(names, AccountMix::Savings, opening);
+            recordLoop("withdraw", {{"accounts", accounts}}, options.operations, [&](uint64_t i) {
+                keepValue(bank->withdraw(names[indexes[i]], Money::fromCents(100)));
+            });
+        }
+        {
+            // Accounts open at zero, so every withdrawal goes overdrawn and
+            // pays the fee. Each account only has room for so many before
+            // the limit, which caps the operation count.
+            Money amount = Money::fromCents(100);
+            uint64_t perAccount = CurrentAccount::defaultOverdraftLimit.getCents() /
+                                  (amount + CurrentAccount::defaultOverdraftFee).getCents();
+            uint64_t operations = std::min<uint64_t>(options.operations, perAccount * accounts);
+            auto bank = makeBank(names, AccountMix::Current, Money());
+            recordLoop("withdraw_overdraft_fee", {{"accounts", accounts}}, operations,
+                       [&](uint64_t i) {
+                keepValue(bank->withdraw(names[i % accounts], amount));
+            });
+        }
+    }
+
+    // Withdrawal checks on randomly picked accounts of both types, with the
+    // product rules reached through visitAccount and through a virtual
+    // call. Single-threaded, so the checks run without the account locks.
+    void benchmarkWithdrawalDispatch(size_t accounts) {
+        std::vector<std::string> names = accountNames(accounts);
+        Bank bank("Benchmark Bank");
+        BenchmarkRandom random(4);
+        for (const auto& name : names) {
+            Money opening = Money::fromCents(int64_t(random.below(200000)));
+            if (random.below(2)) {
+                bank.openSavingsAccount(name, "Holder", opening);
+            } else {
+                bank.openCurrentAccount(name, "Holder", opening);
+            }
+        }
+        std::vector<const Account*> accountList;
+        accountList.reserve(accounts);
+        bank.forEachAccount([&](const Account& account) { accountList.push_back(&account); });
+        std::vector<uint32_t> indexes = randomIndexes(accounts, options.operations, 5);
+        Money amount = Money::fromCents(50000);
+
+        recordLoop("withdrawal_check_closed", {{"accounts", accounts}}, options.operations,
+                   [&](uint64_t i) {
+            Money fee;
+            keepValue(accountList[indexes[i]]->checkWithdrawal(amount, fee));
+            keepValue(fee);
+        });
+
+        static const VirtualWithdrawalRulesFor<SavingsAccount> savingsRules;
+        static const VirtualWithdrawalRulesFor<CurrentAccount> currentRules;
+        std::vector<const VirtualWithdrawalRules*> rules;
+        rules.reserve(accounts);
+        for (const Account* account : accountList) {
+            rules.push_back(account->getKind() == AccountKind::Savings
+                                ? static_cast<const VirtualWithdrawalRules*>(&savingsRules)
+                                : &currentRules);
+        }
+        recordLoop("withdrawal_check_virtual", {{"accounts", accounts}}, options.operations,
+                   [&](uint64_t i) {
+            Money fee;
+            keepValue(rules[indexes[i]]->check(*accountList[indexes[i]], amount, fee));
+            keepValue(fee);
+        });
+    }
+
+    // Whole monthly interest runs at increasing thread counts; reported per
+    // account credited
+    void benchmarkMonthlyInterest(size_t accounts) {
+        std::vector<std::string> names = accountNames(accounts);
+        auto bank = makeBank(names, AccountMix::Savings, Money::fromCents(123456));
+        unsigned runs = static_cast<unsigned>(std::clamp<uint64_t>(options.operations / accounts, 1, 20));
+        for (unsigned threads : threadSteps(options.maxThreads)) {
+            bank->setInterestThreads(threads);
+            bank->creditMonthlyInterest();   // warm-up
+            Measurement measurement;
+            measurement.name = "apply_interest";
+            measurement.parameters = {{"accounts", accounts}, {"threads", threads}};
+            measurement.operations = uint64_t(runs) * accounts;
+            measurement.seconds = measureSeconds([&]() {
+                for (unsigned r = 0; r < runs; ++r) {
+                    keepValue(bank->creditMonthlyInterest());
+                }
+            });
+            record(std::move(measurement));
+        }
+    }
+
+    // The interest arithmetic on its own: the vector kernel, the scalar
+    // kernel, and the old per-account loop through SavingsAccount
+    void benchmarkInterestKernel(size_t accounts) {
+        BenchmarkRandom random(3);
+        std::vector<int64_t> balances(accounts);
+        std::vector<double> rates(accounts);
+        std::vector<int64_t> interest(accounts);
+        for (size_t i = 0; i < accounts; ++i) {
+            balances[i] = static_cast<int64_t>(random.below(100000000));
+            rates[i] = 0.04 / 12;
+        }
+        uint64_t runs = std::clamp<uint64_t>(options.operations * 4 / accounts, 1, 1000);
+
+        auto timeKernel = [&](const char* kernel, auto compute) {
+            Measurement measurement;
+            measurement.name = std::string("interest_kernel_") + kernel;
+            measurement.parameters = {{"accounts", accounts}};
+            measurement.operations = runs * accounts;
+            measurement.seconds = measureSeconds([&]() {
+                for (uint64_t r = 0; r < runs; ++r) {
+                    compute(balances.data(), rates.data(), interest.data(), accounts);
+                    keepValue(interest[r % accounts]);
+                }
+            });
+            record(std::move(measurement));
+        };
+        timeKernel("vector", computeMonthlyInterest);
+        timeKernel("scalar", computeMonthlyInterestScalar);
+
+        Ledger ledger;
+        ProductDefinition product(Bank::savingsProductId, AccountKind::Savings, 
+                                  SavingsAccount::defaultParameters);
+        std::vector<std::string> names = accountNames(accounts);
+        std::vector<std::unique_ptr<SavingsAccount>> savings;
+        savings.reserve(accounts);
+        for (size_t i = 0; i < accounts; ++i) {
+            savings.push_back(std::make_unique<SavingsAccount>(
+                ledger, static_cast<uint32_t>(i), names[i], "Holder", product,
+                Money::fromCents(balances[i])));
+        }
+        uint64_t loopRuns = std::clamp<uint64_t>(options.operations / accounts, 1, 20);
+        Measurement measurement;
+        measurement.name = "interest_per_account_loop";
+        measurement.parameters = {{"accounts", accounts}};
+        measurement.operations = loopRuns * accounts;
+        measurement.seconds = measureSeconds([&]() {
+            for (uint64_t r = 0; r < loopRuns; ++r) {
+                for (auto& account : savings) {
+                    keepValue(account->applyInterest());
+                }
+            }
+        });
+        record(std::move(measurement));
+    }
+
+    // Formatting one account's history the way the menu does
+    void benchmarkHistoryFormat() {
+        for (size_t entries : {size_t(10), size_t(1000)}) {
+            Bank bank("Benchmark Bank");
+            bank.openCurrentAccount("BM0", "Holder", Money::fromCents(10000));
+            Account* account = bank.findAccount("BM0");
+            for (size_t i = 1; i < entries; ++i) {
+                account->applyDeposit(Money::fromCents(100 + int64_t(i)));
+            }
+            uint64_t runs = std::max<uint64_t>(1, options.operations / entries / 4);
+            std::ostringstream out;
+            Measurement measurement;
+            measurement.name = "history_format";
+            measurement.parameters = {{"entries", entries}};
+            measurement.operations = runs * entries;
+            measurement.seconds = measureSeconds([&]() {
+                for (uint64_t r = 0; r < runs; ++r) {
+                    out.str(std::string());
+                    for (const auto& transaction : account->getTransactionHistory()) {
+                        transaction.writeTo(out);
+                    }
+                    keepValue(out.tellp());
+                }
+            });
+            measurement.metrics = {{"transaction_bytes", double(sizeof(Transaction))}};
+            record(std::move(measurement));
+        }
+    }
+
+    void benchmarkLedgerExport(size_t accounts) {
+        std::vector<std::string> names = accountNames(accounts);
+        auto bank = makeBank(names, AccountMix::Current, Money::fromCents(10000));
+        for (uint64_t i = 0; i < options.operations; ++i) {
+            bank->applyDeposit(names[i % accounts], Money::fromCents(100));
+        }
+        uint64_t entries = accounts + options.operations;
+        Measurement measurement;
+        measurement.name = "ledger_export_csv";
+        measurement.parameters = {{"entries", entries}};
+        measurement.operations = entries;
+        measurement.seconds = measureSeconds([&]() {
+            bank->exportTransactions("/dev/null");
+        });
+        record(std::move(measurement));
+    }
+
+    // A batch through applyBatch against the same operations one call at
+    // a time
+    void benchmarkBatch(size_t accounts) {
+        std::vector<std::string> names = accountNames(accounts);
+        std::vector<uint32_t> indexes = randomIndexes(accounts, options.operations, 4);
+        std::vector<BatchOperation> batch;
+        batch.reserve(options.operations);
+        for (uint64_t i = 0; i < options.operations; ++i) {
+            batch.push_back(BatchOperation{i % 2 ? OperationType::Withdraw : OperationType::Deposit,
+                                           names[indexes[i]], Money::fromCents(100)});
+        }
+        {
+            auto bank = makeBank(names, AccountMix::Current, Money::fromCents(100000));
+            Measurement measurement;
+            measurement.name = "apply_batch";
+            measurement.parameters = {{"accounts", accounts}};
+            measurement.operations = batch.size();
+            measurement.seconds = measureSeconds([&]() {
+                keepValue(bank->applyBatch(batch).size());
+            });
+            record(std::move(measurement));
+        }
+        {
+            auto bank = makeBank(names, AccountMix::Current, Money::fromCents(100000));
+            recordLoop("apply_single", {{"accounts", accounts}}, batch.size(), [&](uint64_t i) {
+                const BatchOperation& operation = batch[i];
+                keepValue(operation.type == OperationType::Deposit
+                              ? bank->applyDeposit(operation.accountNumber, operation.amount)
+                              : bank->applyWithdrawal(operation.accountNumber, operation.amount));
+            });
+        }
+    }
+
+    // A generated workload through applyBatch, one batch per burst, with
+    // uniform and Zipfian account popularity
+    void benchmarkWorkloadBatch(size_t accounts) {
+        for (unsigned thetaPercent : {0u, 99u}) {
+            WorkloadSpec spec;
+            spec.savingsAccounts = static_cast<uint32_t>(accounts / 2);
+            spec.currentAccounts = static_cast<uint32_t>(accounts - accounts / 2);
+            spec.zipfTheta = thetaPercent / 100.0;
+            spec.mix[0] = 0;
+            spec.mix[1] = 50;
+            spec.mix[2] = 50;
+            spec.mix[3] = 0;
+            WorkloadGenerator generator(spec);
+            std::vector<WorkloadAccount> workloadAccounts = generator.generateAccounts();
+            Bank bank("Benchmark Bank");
+            openWorkloadAccounts(bank, workloadAccounts);
+
+            std::vector<std::vector<BatchOperation>> batches;
+            std::vector<WorkloadOperation> burst;
+            uint64_t operations = 0;
+            while (operations < options.operations) {
+                burst.clear();
+                generator.nextBurst(burst);
+                batches.emplace_back();
+                appendBatchOperations(burst, workloadAccounts, batches.back());
+                operations += batches.back().size();
+            }
+            Measurement measurement;
+            measurement.name = "workload_batch";
+            measurement.parameters = {{"accounts", accounts}, {"zipf_theta_x100", thetaPercent}};
+            measurement.operations = operations;
+            measurement.seconds = measureSeconds([&]() {
+                for (const auto& batch : batches) {
+                    keepValue(bank.applyBatch(batch).size());
+                }
+            });
+            measurement.metrics = {{"batches", double(batches.size())}};
+            record(std::move(measurement));
+        }
+    }
+
+    // Deposits from many threads, spread over a varying number of hot
+    // accounts: one account shows lock contention, many show scaling
+    void benchmarkConcurrentDeposits() {
+        std::vector<std::string> names = accountNames(65536);
+        auto bank = makeBank(names, AccountMix::Current, Money());
+        for (size_t hot : {size_t(1), size_t(16), size_t(65536)}) {
+            for (unsigned threads : threadSteps(options.maxThreads)) {
+                uint64_t perThread = options.operations / threads;
+                Measurement measurement;
+                measurement.name = "concurrent_deposit";
+                measurement.parameters = {{"hot_accounts", hot}, {"threads", threads}};
+                measurement.operations = perThread * threads;
+                measurement.seconds = measureThreads(threads, [&](unsigned t) {
+                    BenchmarkRandom random(100 + t);
+                    for (uint64_t i = 0; i < perThread; ++i) {
+                        keepValue(bank->applyDeposit(names[random.below(hot)], Money::fromCents(1)));
+                    }
+                });
+                record(std::move(measurement));
+            }
+        }
+    }
+
+    // Random transfers between a small pool of accounts
+    void benchmarkTransfers() {
+        for (size_t pool : {size_t(16), size_t(65536)}) {
+            std::vector<std::string> names = accountNames(pool);
+            auto bank = makeBank(names, AccountMix::Current, Money::fromCents(100000000));
+            for (unsigned threads : threadSteps(options.maxThreads)) {
+                uint64_t perThread = options.operations / threads / 2;
+                Measurement measurement;
+                measurement.name = "transfer";
+                measurement.parameters = {{"accounts", pool}, {"threads", threads}};
+                measurement.operations = perThread * threads;
+                measurement.seconds = measureThreads(threads, [&](unsigned t) {
+                    BenchmarkRandom random(200 + t);
+                    for (uint64_t i = 0; i < perThread; ++i) {
+                        size_t from = random.below(pool);
+                        size_t to = (from + 1 + random.below(pool - 1)) % pool;
+                        keepValue(bank->applyTransfer(names[from], names[to], Money::fromCents(1)));
+                    }
+                });
+                record(std::move(measurement));
+            }
+        }
+    }
+
+    // Lock-free balance reads on accounts that writer threads keep updating
+    void benchmarkBalanceReads() {
+        const size_t hot = 16;
+        std::vector<std::string> names = accountNames(hot);
+        auto bank = makeBank(names, AccountMix::Current, Money());
+        std::vector<Account*> accounts;
+        for (const auto& name : names) {
+            accounts.push_back(bank->findAccount(name));
+        }
+        for (unsigned writers : {0u, 1u, 4u}) {
+            if (writers >= options.maxThreads && writers > 0) continue;
+            std::atomic<bool> stop{false};
+            std::vector<std::thread> pool;
+            for (unsigned w = 0; w < writers; ++w) {
+                pool.emplace_back([&, w]() {
+                    BenchmarkRandom random(300 + w);
+                    while (!stop.load(std::memory_order_relaxed)) {
+                        accounts[random.below(hot)]->applyDeposit(Money::fromCents(1));
+                    }
+                });
+            }
+            recordLoop("balance_read", {{"writers", writers}}, options.operations, [&](uint64_t i) {
+                keepValue(accounts[i % hot]->readBalance());
+            });
+            stop.store(true);
+            for (auto& worker : pool) {
+                worker.join();
+            }
+        }
+    }
+
+    // Cost the activity log adds to each operation on the producing thread
+    void benchmarkActivityLog() {
+        std::vector<std::string> names = accountNames(65536);
+        for (unsigned threads : threadSteps(std::min(options.maxThreads, 4u))) {
+            auto bank = makeBank(names, AccountMix::Current, Money());
+            ActivityLogger logger(1 << 16, OverflowPolicy::Drop);
+            if (!logger.open("/dev/null")) return;
+            bank->setEventSink(&logger);
+            uint64_t perThread = options.operations / threads;
+            Measurement measurement;
+            measurement.name = "activity_log_deposit";
+            measurement.parameters = {{"threads", threads}};
+            measurement.operations = perThread * threads;
+            measurement.seconds = measureThreads(threads, [&](unsigned t) {
+                BenchmarkRandom random(400 + t);
+                for (uint64_t i = 0; i < perThread; ++i) {
+                    keepValue(bank->applyDeposit(names[random.below(names.size())], Money::fromCents(1)));
+                }
+            });
+            bank->setEventSink(nullptr);
+            logger.close();
+            measurement.metrics = {{"dropped", double(logger.getDroppedCount())}};
+            record(std::move(measurement));
+        }
+    }
+
+    // Durable deposits against the group commit policy. Each thread waits
+    // for its deposit to be durable before the next, so at most one record
+    // per thread is pending. max_delay_us=0 is the default policy (sync as
+    // soon as anything is waiting); the delayed runs wait up to 2 ms for
+    // max_batch records, with max_batch equal to the thread count so a
+    // batch can fill before the delay runs out.
+    void benchmarkGroupCommit() {
+        for (unsigned threads : {1u, 16u, 64u}) {
+            std::vector<std::string> names = accountNames(threads);
+            for (bool delayed : {false, true}) {
+                GroupCommitPolicy policy;
+                if (delayed) {
+                    policy.maxBatch = threads;
+                    policy.maxDelay = std::chrono::microseconds(2000);
+                }
+                std::string dir = options.dataDir + "/group_commit";
+                removeDataDirectory(dir);
+                Measurement measurement;
+                {
+                    Bank bank("Benchmark Bank");
+                    if (!bank.openDataDirectory(dir, policy, 0).ok) return;
+                    for (const auto& name : names) {
+                        bank.openCurrentAccount(name, "Holder", Money());
+                    }
+                    bank.commitJournal();
+                    uint64_t perThread = std::max<uint64_t>(1, options.operations / 400);
+                    measurement.name = "durable_deposit";
+                    measurement.parameters = {{"max_batch", policy.maxBatch},
+                                              {"max_delay_us", uint64_t(policy.maxDelay.count())},
+                                              {"threads", threads}};
+                    measurement.operations = perThread * threads;
+                    measurement.seconds = measureThreads(threads, [&](unsigned t) {
+                        for (uint64_t i = 0; i < perThread; ++i) {
+                            keepValue(bank.deposit(names[t], Money::fromCents(1)));
+                        }
+                    });
+                }
+                removeDataDirectory(dir);
+                record(std::move(measurement));
+            }
+        }
+    }
+
+    // Startup time from a checkpoint plus a log tail of a tenth as many
+    // operations again
+    void benchmarkRecovery(size_t accounts) {
+        std::string dir = options.dataDir + "/recovery";
+        removeDataDirectory(dir);
+        std::vector<std::string> names = accountNames(accounts);
+        {
+            Bank bank("Benchmark Bank");
+            if (!bank.openDataDirectory(dir, GroupCommitPolicy(), 0).ok) return;
+            for (const auto& name : names) {
+                bank.openCurrentAccount(name, "Holder", Money::fromCents(10000));
+            }
+            bank.commitJournal();
+            bank.checkpoint();
+            for (size_t i = 0; i < accounts; i += 10) {
+                bank.applyDeposit(names[i], Money::fromCents(100));
+            }
+            bank.commitJournal();
+        }
+        Bank bank("Benchmark Bank");
+        RecoveryStats stats = bank.openDataDirectory(dir, GroupCommitPolicy(), 0);
+        removeDataDirectory(dir);
+        if (!stats.ok) return;
+        Measurement measurement;
+        measurement.name = "recovery";
+        measurement.parameters = {{"accounts", accounts}};
+        measurement.operations = stats.snapshotEntries + stats.replayedRecords;
+        measurement.seconds = stats.seconds;
+        measurement.metrics = {{"snapshot_entries", double(stats.snapshotEntries)},
+                               {"replayed_records", double(stats.replayedRecords)}};
+        record(std::move(measurement));
+    }
+
+public:
+    explicit BenchmarkSuite(BenchmarkOptions benchmarkOptions) : options(std::move(benchmarkOptions)) {}
+
+    void run() {
+        for (size_t accounts : options.accountCounts) {
+            if (selected("account_creation")) benchmarkAccountCreation(accounts);
+            if (selected("account_bulk_load")) benchmarkBulkLoad(accounts);
+            if (selected("find_account")) benchmarkFindAccount(accounts);
+            if (selected("deposit") || selected("withdraw")) benchmarkDepositWithdraw(accounts);
+            if (selected("withdrawal_check")) benchmarkWithdrawalDispatch(accounts);
+            if (selected("apply_interest")) benchmarkMonthlyInterest(accounts);
+            if (selected("interest_kernel") || selected("interest_per_account")) {
+                benchmarkInterestKernel(accounts);
+            }
+            if (selected("apply_batch") || selected("apply_single")) benchmarkBatch(accounts);
+            if (selected("workload_batch")) benchmarkWorkloadBatch(accounts);
+            if (selected("recovery")) benchmarkRecovery(accounts);
+        }
+        if (selected("find_account")) {
+            for (size_t accounts : options.lookupCounts) benchmarkFindAccount(accounts);
+        }
+        if (selected("history_format")) benchmarkHistoryFormat();
+        if (selected("ledger_export")) benchmarkLedgerExport(options.accountCounts.front());
+        if (selected("concurrent_deposit")) benchmarkConcurrentDeposits();
+        if (selected("transfer")) benchmarkTransfers();
+        if (selected("balance_read")) benchmarkBalanceReads();
+        if (selected("activity_log")) benchmarkActivityLog();
+        if (selected("durable_deposit")) benchmarkGroupCommit();
+    }
+
+    void writeJson(std::ostream& out) const {
+        out << "{\n"
+            << "  \"suite\": \"bank_benchmark\",\n"
+            << "  \"timestamp\": " << std::time(nullptr) << ",\n"
+            << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+#if defined(__AVX2__)
+            << "  \"avx2\": true,\n"
+#else
+            << "  \"avx2\": false,\n"
+#endif
+            << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+            << "  \"results\": [";
+        out << std::setprecision(12);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Measurement& m = results[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << m.name << "\", \"parameters\": {";
+            for (size_t p = 0; p < m.parameters.size(); ++p) {
+                out << (p ? ", " : "") << '"' << m.parameters[p].first << "\": " << m.parameters[p].second;
+            }
+            double nsPerOp = m.operations ? m.seconds * 1e9 / m.operations : 0;
+            double opsPerSec = m.seconds > 0 ? m.operations / m.seconds : 0;
+            out << "}, \"operations\": " << m.operations
+                << ", \"seconds\": " << m.seconds
+                << ", \"ns_per_op\": " << nsPerOp
+                << ", \"ops_per_sec\": " << opsPerSec;
+            if (!m.metrics.empty()) {
+                out << ", \"metrics\": {";
+                for (size_t k = 0; k < m.metrics.size(); ++k) {
+                    out << (k ? ", " : "") << '"' << m.metrics[k].first << "\": " << m.metrics[k].second;
+                }
+                out << '}';
+            }
+            out << '}';
+        }
+        out << "\n  ]\n}" << std::endl;
+    }
+};
+
+static bool parseCounts(const std::string& text, std::vector<size_t>& counts) {
+    counts.clear();
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        char* end = nullptr;
+        unsigned long long value = std::strtoull(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || value == 0 || value > UINT32_MAX) return false;
+        counts.push_back(static_cast<size_t>(value));
+    }
+    return !counts.empty();
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--accounts N,N,...] [--operations N] [--threads N]\n"
+              << "       [--filter TEXT] [--output FILE] [--data-dir DIR] [--quick]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--accounts" && i + 1 < argc) {
+            if (!parseCounts(argv[++i], options.accountCounts)) {
+                std::cerr << "--accounts needs comma-separated positive counts" << std::endl;
+                return 1;
+            }
+            options.lookupCounts.clear();
+        } else if (arg == "--operations" && i + 1 < argc) {
+            options.operations = std::max(1ull, std::stoull(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.maxThreads = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            options.outputPath = argv[++i];
+        } else if (arg == "--data-dir" && i + 1 < argc) {
+            options.dataDir = argv[++i];
+        } else if (arg == "--quick") {
+            options.accountCounts = {1000, 100000};
+            options.lookupCounts.clear();
+            options.operations = 200000;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    bool temporaryDir = options.dataDir.empty();
+    if (temporaryDir) {
+        char pattern[] = "/tmp/bank_benchmark.XXXXXX";
+        if (!::mkdtemp(pattern)) {
+            std::cerr << "Cannot create a scratch directory" << std::endl;
+            return 1;
+        }
+        options.dataDir = pattern;
+    }
+    std::string dataDir = options.dataDir;
+    std::string outputPath = options.outputPath;
+
+    BenchmarkSuite suite(std::move(options));
+    suite.run();
+    if (temporaryDir) ::rmdir(dataDir.c_str());
+
+    if (outputPath.empty()) {
+        suite.writeJson(std::cout);
+    } else {
+        std::ofstream out(outputPath);
+        suite.writeJson(out);
+        if (!out) {
+            std::cerr << "Cannot write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
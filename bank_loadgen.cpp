@@ -0,0 +1,408 @@
+// Load generator for the bank server. Opens several connections, keeps a
+// fixed number of pipelined requests in flight on each, and reports
+// throughput and latency percentiles.
+//
+// Build: cmake --preset release && cmake --build --preset release
+// Usage: bank_loadgen (--unix PATH | --tcp PORT) [--connections N] [--depth N]
+//                     [--requests N] [--accounts N] [--mix B,D,W,T,H]
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "bank_protocol.h"
+
+struct LoadOptions {
+    std::string unixPath;
+    int tcpPort = -1;
+    unsigned connections = 4;
+    unsigned depth = 16;            // requests in flight per connection
+    uint64_t requests = 200000;     // per connection
+    unsigned accounts = 10000;
+    // Percentages of balance, deposit, withdraw, transfer and history requests
+    unsigned mix[5] = {80, 8, 7, 4, 1};
+};
+
+// Per-connection results, merged after the run
+struct ConnectionStats {
+    std::vector<uint32_t> latenciesNanos;
+    uint64_t statusCounts[256] = {};
+    std::string error;
+};
+
+static int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string accountName(unsigned i) {
+    return "LG" + std::to_string(i);
+}
+
+static int connectToServer(const LoadOptions& options) {
+    int fd;
+    if (!options.unixPath.empty()) {
+        sockaddr_un address{};
+        if (options.unixPath.size() >= sizeof(address.sun_path)) return -1;
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, options.unixPath.c_str(), options.unixPath.size() + 1);
+        fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+    } else {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(options.tcpPort));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return -1;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+static bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += size_t(n);
+    }
+    return true;
+}
+
+// Blocking client connection that sends frames and reads responses in order
+class ClientConnection {
+private:
+    int fd;
+    std::string input;
+    size_t inputStart = 0;
+    std::vector<char> readBuffer;
+
+public:
+    explicit ClientConnection(int socketFd) : fd(socketFd), readBuffer(1 << 16) {}
+
+    ~ClientConnection() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    ClientConnection(const ClientConnection&) = delete;
+    ClientConnection& operator=(const ClientConnection&) = delete;
+
+    bool send(const std::string& data) { return sendAll(fd, data); }
+
+    // Returns the next response frame without its length field, blocking
+    // until it has arrived; empty on disconnect or a malformed frame
+    std::string_view nextResponse() {
+        for (;;) {
+            size_t frameSize = completeFrameSize(input.data() + inputStart, input.size() - inputStart);
+            if (frameSize == SIZE_MAX) return std::string_view();
+            if (frameSize > 0) {
+                std::string_view frame(input.data() + inputStart + sizeof(uint32_t),
+                                       frameSize - sizeof(uint32_t));
+                inputStart += frameSize;
+                return frame;
+            }
+            if (inputStart > 0) {
+                input.erase(0, inputStart);
+                inputStart = 0;
+            }
+            ssize_t n = ::read(fd, readBuffer.data(), readBuffer.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return std::string_view();
+            input.append(readBuffer.data(), size_t(n));
+        }
+    }
+
+    // True while a complete frame is already buffered
+    bool hasBufferedResponse() const {
+        size_t frameSize = completeFrameSize(input.data() + inputStart, input.size() - inputStart);
+        return frameSize > 0 && frameSize != SIZE_MAX;
+    }
+};
+
+// Small, fast generator for picking request types and accounts
+class Xorshift {
+private:
+    uint64_t state;
+
+public:
+    explicit Xorshift(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    unsigned below(unsigned bound) { return static_cast<unsigned>(next() % bound); }
+};
+
+static void appendRandomRequest(std::string& out, uint32_t requestId, const LoadOptions& options,
+                                Xorshift& random, const std::vector<std::string>& names) {
+    const std::string& account = names[random.below(options.accounts)];
+    unsigned pick = random.below(100);
+    unsigned type = 0;
+    while (type < 4 && pick >= options.mix[type]) {
+        pick -= options.mix[type];
+        ++type;
+    }
+    switch (type) {
+        case 0:
+            appendBalanceRequest(out, requestId, account);
+            break;
+        case 1:
+            appendAmountRequest(out, requestId, RequestType::Deposit, account, 1000 + random.below(10000));
+            break;
+        case 2:
+            appendAmountRequest(out, requestId, RequestType::Withdraw, account, 1000 + random.below(10000));
+            break;
+        case 3:
+            appendTransferRequest(out, requestId, account, names[random.below(options.accounts)],
+                                  100 + random.below(1000));
+            break;
+        default:
+            appendHistoryRequest(out, requestId, account, 10);
+            break;
+    }
+}
+
+static void runConnection(const LoadOptions& options, const std::vector<std::string>& names,
+                          unsigned index, ConnectionStats& stats) {
+    int fd = connectToServer(options);
+    if (fd < 0) {
+        stats.error = std::string("connect: ") + std::strerror(errno);
+        return;
+    }
+    ClientConnection connection(fd);
+    Xorshift random(index + 1);
+    stats.latenciesNanos.reserve(options.requests);
+
+    // Send times of in-flight requests; responses arrive in request order
+    std::vector<int64_t> sendTimes(options.depth);
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    std::string out;
+
+    auto issue = [&](int64_t now) {
+        appendRandomRequest(out, static_cast<uint32_t>(sent), options, random, names);
+        sendTimes[sent % options.depth] = now;
+        ++sent;
+    };
+
+    int64_t start = nowNanos();
+    while (sent < options.requests && sent < options.depth) {
+        issue(start);
+    }
+    if (!connection.send(out)) {
+        stats.error = "send failed";
+        return;
+    }
+
+    while (received < sent) {
+        out.clear();
+        // Drain every response already buffered before sending the refills
+        do {
+            std::string_view frame = connection.nextResponse();
+            if (frame.size() < sizeof(uint32_t) + 1) {
+                stats.error = "connection closed by server";
+                return;
+            }
+            int64_t now = nowNanos();
+            uint32_t requestId;
+            std::memcpy(&requestId, frame.data(), sizeof(requestId));
+            if (requestId != static_cast<uint32_t>(received)) {
+                stats.error = "response out of order";
+                return;
+            }
+            stats.latenciesNanos.push_back(static_cast<uint32_t>(
+                std::min<int64_t>(now - sendTimes[received % options.depth], UINT32_MAX)));
+            ++stats.statusCounts[static_cast<uint8_t>(frame[sizeof(uint32_t)])];
+            ++received;
+            if (sent < options.requests) {
+                issue(now);
+            }
+        } while (connection.hasBufferedResponse());
+        if (!out.empty() && !connection.send(out)) {
+            stats.error = "send failed";
+            return;
+        }
+    }
+}
+
+// Creates the accounts used by the run; existing ones are reused
+static bool createAccounts(const LoadOptions& options, const std::vector<std::string>& names) {
+    int fd = connectToServer(options);
+    if (fd < 0) {
+        std::cerr << "connect: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    ClientConnection connection(fd);
+    std::string out;
+    for (unsigned i = 0; i < options.accounts; ++i) {
+        appendOpenRequest(out, i, RequestType::OpenCurrent, names[i], 100000000, "Load Generator");
+    }
+    if (!connection.send(out)) return false;
+    for (unsigned i = 0; i < options.accounts; ++i) {
+        std::string_view frame = connection.nextResponse();
+        if (frame.size() < sizeof(uint32_t) + 1) return false;
+        auto status = static_cast<ResponseStatus>(frame[sizeof(uint32_t)]);
+        if (status != ResponseStatus::Ok && status != ResponseStatus::AccountExists) {
+            std::cerr << "Could not create " << names[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static const char* responseStatusName(uint8_t status) {
+    switch (static_cast<ResponseStatus>(status)) {
+        case ResponseStatus::Ok: return "Ok";
+        case ResponseStatus::AccountNotFound: return "AccountNotFound";
+        case ResponseStatus::InvalidAmount: return "InvalidAmount";
+        case ResponseStatus::MinimumBalanceBreach: return "MinimumBalanceBreach";
+        case ResponseStatus::OverdraftLimitExceeded: return "OverdraftLimitExceeded";
+        case ResponseStatus::SameAccount: return "SameAccount";
+        case ResponseStatus::AccountExists: return "AccountExists";
+        case ResponseStatus::BadRequest: return "BadRequest";
+    }
+    return "Unknown";
+}
+
+static bool parseMix(const std::string& text, unsigned mix[5]) {
+    unsigned values[5];
+    size_t position = 0;
+    unsigned total = 0;
+    for (int i = 0; i < 5; ++i) {
+        size_t comma = text.find(',', position);
+        if ((i < 4) != (comma != std::string::npos)) return false;
+        try {
+            values[i] = static_cast<unsigned>(std::stoul(text.substr(position, comma - position)));
+        } catch (const std::exception&) {
+            return false;
+        }
+        total += values[i];
+        position = comma + 1;
+    }
+    if (total != 100) return false;
+    std::copy(values, values + 5, mix);
+    return true;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " (--unix PATH | --tcp PORT) [--connections N]"
+              << " [--depth N] [--requests N] [--accounts N] [--mix B,D,W,T,H]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--unix" && i + 1 < argc) {
+            options.unixPath = argv[++i];
+        } else if (arg == "--tcp" && i + 1 < argc) {
+            options.tcpPort = std::stoi(argv[++i]);
+        } else if (arg == "--connections" && i + 1 < argc) {
+            options.connections = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg == "--depth" && i + 1 < argc) {
+            options.depth = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg == "--requests" && i + 1 < argc) {
+            options.requests = std::stoull(argv[++i]);
+        } else if (arg == "--accounts" && i + 1 < argc) {
+            options.accounts = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg == "--mix" && i + 1 < argc) {
+            if (!parseMix(argv[++i], options.mix)) {
+                std::cerr << "--mix needs five comma-separated percentages adding up to 100" << std::endl;
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.unixPath.empty() == (options.tcpPort < 0)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> names;
+    names.reserve(options.accounts);
+    for (unsigned i = 0; i < options.accounts; ++i) {
+        names.push_back(accountName(i));
+    }
+    if (!createAccounts(options, names)) {
+        return 1;
+    }
+
+    std::vector<ConnectionStats> stats(options.connections);
+    std::vector<std::thread> threads;
+    int64_t start = nowNanos();
+    for (unsigned i = 0; i < options.connections; ++i) {
+        threads.emplace_back(runConnection, std::cref(options), std::cref(names), i, std::ref(stats[i]));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = double(nowNanos() - start) / 1e9;
+
+    std::vector<uint32_t> latencies;
+    uint64_t statusCounts[256] = {};
+    for (const auto& connectionStats : stats) {
+        if (!connectionStats.error.empty()) {
+            std::cerr << "Connection error: " << connectionStats.error << std::endl;
+        }
+        latencies.insert(latencies.end(), connectionStats.latenciesNanos.begin(),
+                         connectionStats.latenciesNanos.end());
+        for (int s = 0; s < 256; ++s) {
+            statusCounts[s] += connectionStats.statusCounts[s];
+        }
+    }
+    if (latencies.empty()) {
+        std::cerr << "No responses received." << std::endl;
+        return 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        size_t rank = static_cast<size_t>(p * double(latencies.size() - 1));
+        return double(latencies[rank]) / 1000.0;
+    };
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Connections: " << options.connections << ", pipeline depth: " << options.depth
+              << ", accounts: " << options.accounts << std::endl;
+    std::cout << "Requests: " << latencies.size() << " in " << std::setprecision(3) << seconds << " s ("
+              << std::setprecision(0) << double(latencies.size()) / seconds << " req/s)" << std::endl;
+    std::cout << std::setprecision(1) << "Latency us: p50 " << percentile(0.50) << ", p99 "
+              << percentile(0.99) << ", p99.9 " << percentile(0.999) << ", max "
+              << double(latencies.back()) / 1000.0 << std::endl;
+    for (int s = 0; s < 256; ++s) {
+        if (statusCounts[s]) {
+            std::cout << "  " << responseStatusName(static_cast<uint8_t>(s)) << ": "
+                      << statusCounts[s] << std::endl;
+        }
+    }
+    return 0;
+}
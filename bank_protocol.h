@@ -0,0 +1,187 @@
+#ifndef BANK_PROTOCOL_H
+#define BANK_PROTOCOL_H
+
+// Binary request/response protocol spoken by the bank server and its
+// clients. Every message is a frame:
+//
+//   u32 length       bytes that follow this field
+//   u32 requestId    chosen by the client, echoed in the response
+//   u8  type         RequestType in requests, ResponseStatus in responses
+//   ...              body, see below
+//
+// Integers are little-endian and amounts are signed cents. Account numbers
+// are a u8 length followed by that many bytes. Requests may be pipelined:
+// a client can send any number of frames without waiting, and responses
+// come back on the same connection in request order.
+//
+// Request bodies:
+//   OpenSavings, OpenCurrent   account, i64 initial deposit, u8 length + holder name
+//   Deposit, Withdraw          account, i64 amount
+//   Balance                    account
+//   Transfer                   from account, to account, i64 amount
+//   History                    account, u32 maximum number of entries
+//
+// Response bodies (only when the status is Ok):
+//   Deposit, Withdraw, Balance i64 balance after the operation
+//   History                    u32 count, then count entries of
+//                              u8 type, i64 amount, i64 balance after,
+//                              i64 timestamp in nanoseconds since the epoch,
+//                              oldest first
+//   others                     empty
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+constexpr uint32_t protocolMaxFrameLength = 1 << 16;
+constexpr size_t protocolMaxAccountLength = 255;
+constexpr uint32_t protocolMaxHistoryEntries = 1024;
+constexpr size_t protocolHistoryEntrySize = 1 + 8 + 8 + 8;
+
+enum class RequestType : uint8_t {
+    OpenSavings = 1,
+    OpenCurrent = 2,
+    Deposit = 3,
+    Withdraw = 4,
+    Balance = 5,
+    Transfer = 6,
+    History = 7
+};
+
+// Values 0-6 match the server's OperationStatus
+enum class ResponseStatus : uint8_t {
+    Ok = 0,
+    AccountNotFound = 1,
+    InvalidAmount = 2,
+    MinimumBalanceBreach = 3,
+    OverdraftLimitExceeded = 4,
+    SameAccount = 5,
+    AccountExists = 6,
+    BadRequest = 100
+};
+
+// Appends one frame to a buffer. The length field is filled in by finish().
+class FrameWriter {
+private:
+    std::string& out;
+    size_t start;
+
+public:
+    FrameWriter(std::string& buffer, uint32_t requestId, uint8_t type)
+        : out(buffer), start(buffer.size()) {
+        put<uint32_t>(0);
+        put<uint32_t>(requestId);
+        put<uint8_t>(type);
+    }
+
+    template <typename T>
+    void put(T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    // Names longer than 255 bytes are truncated
+    void putShortString(std::string_view value) {
+        size_t length = value.size() < protocolMaxAccountLength ? value.size() : protocolMaxAccountLength;
+        put<uint8_t>(static_cast<uint8_t>(length));
+        out.append(value.data(), length);
+    }
+
+    void finish() {
+        uint32_t length = static_cast<uint32_t>(out.size() - start - sizeof(uint32_t));
+        std::memcpy(&out[start], &length, sizeof(length));
+    }
+};
+
+// Reads the fields of one frame; any read past the end marks it invalid
+class FrameReader {
+private:
+    const char* cursor;
+    const char* end;
+    bool valid = true;
+
+public:
+    FrameReader(const char* data, size_t size) : cursor(data), end(data + size) {}
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (size_t(end - cursor) < sizeof(T)) {
+            valid = false;
+            return value;
+        }
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+
+    std::string_view getShortString() {
+        uint8_t length = get<uint8_t>();
+        if (!valid || size_t(end - cursor) < length) {
+            valid = false;
+            return std::string_view();
+        }
+        std::string_view value(cursor, length);
+        cursor += length;
+        return value;
+    }
+
+    bool atEnd() const { return cursor == end; }
+    bool ok() const { return valid; }
+};
+
+// Size of the first frame in data including its length field, 0 if more
+// bytes are needed, or SIZE_MAX if the frame exceeds the protocol limit
+inline size_t completeFrameSize(const char* data, size_t size) {
+    if (size < sizeof(uint32_t)) return 0;
+    uint32_t length;
+    std::memcpy(&length, data, sizeof(length));
+    if (length > protocolMaxFrameLength || length < sizeof(uint32_t) + 1) return SIZE_MAX;
+    return size - sizeof(uint32_t) >= length ? length + sizeof(uint32_t) : 0;
+}
+
+inline void appendOpenRequest(std::string& out, uint32_t requestId, RequestType type,
+                              std::string_view account, int64_t initialCents,
+                              std::string_view holderName) {
+    FrameWriter writer(out, requestId, static_cast<uint8_t>(type));
+    writer.putShortString(account);
+    writer.put<int64_t>(initialCents);
+    writer.putShortString(holderName);
+    writer.finish();
+}
+
+// Deposit or Withdraw
+inline void appendAmountRequest(std::string& out, uint32_t requestId, RequestType type,
+                                std::string_view account, int64_t cents) {
+    FrameWriter writer(out, requestId, static_cast<uint8_t>(type));
+    writer.putShortString(account);
+    writer.put<int64_t>(cents);
+    writer.finish();
+}
+
+inline void appendBalanceRequest(std::string& out, uint32_t requestId, std::string_view account) {
+    FrameWriter writer(out, requestId, static_cast<uint8_t>(RequestType::Balance));
+    writer.putShortString(account);
+    writer.finish();
+}
+
+inline void appendTransferRequest(std::string& out, uint32_t requestId, std::string_view fromAccount,
+                                  std::string_view toAccount, int64_t cents) {
+    FrameWriter writer(out, requestId, static_cast<uint8_t>(RequestType::Transfer));
+    writer.putShortString(fromAccount);
+    writer.putShortString(toAccount);
+    writer.put<int64_t>(cents);
+    writer.finish();
+}
+
+inline void appendHistoryRequest(std::string& out, uint32_t requestId, std::string_view account,
+                                 uint32_t maxEntries) {
+    FrameWriter writer(out, requestId, static_cast<uint8_t>(RequestType::History));
+    writer.putShortString(account);
+    writer.put<uint32_t>(maxEntries);
+    writer.finish();
+}
+
+#endif
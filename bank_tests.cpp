@@ -0,0 +1,458 @@
+// Checks of the banking core: money parsing, formatting and rounding, the
+// withdrawal rules of both products, transfers, and recovery from a
+// snapshot plus write-ahead log. Exits non-zero if any check fails.
+//
+// Build: cmake --preset release && cmake --build --preset release
+// Run:   ctest --test-dir build/release --output-on-failure
+
+#include "banking_core.h"
+#include <filesystem>
+#include <cstdlib>
+
+static int checksRun = 0;
+static int checksFailed = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static void check(bool passed, const char* text, const char* file, int line) {
+    ++checksRun;
+    if (!passed) {
+        ++checksFailed;
+        std::cout << file << ":" << line << ": check failed: " << text << std::endl;
+    }
+}
+
+static Money cents(int64_t value) { return Money::fromCents(value); }
+
+static Money parsed(std::string_view text, RoundingMode mode = RoundingMode::HalfEven) {
+    Money amount = cents(-999999);
+    bool ok = Money::parse(text, amount, mode);
+    CHECK(ok);
+    return amount;
+}
+
+// A fresh directory under the system temporary directory
+static std::string makeTempDirectory() {
+    std::string pattern = (std::filesystem::temp_directory_path() / "bank_tests.XXXXXX").string();
+    if (!mkdtemp(pattern.data())) {
+        std::cout << "cannot create a temporary directory" << std::endl;
+        std::exit(1);
+    }
+    return pattern;
+}
+
+static void testMoneyParse() {
+    CHECK(parsed("500") == cents(50000));
+    CHECK(parsed("-12.5") == cents(-1250));
+    CHECK(parsed("+0.07") == cents(7));
+    CHECK(parsed(".5") == cents(50));
+    CHECK(parsed("92233720368547758.07") == cents(INT64_MAX));
+
+    Money amount;
+    for (const char* bad : {"", "-", ".", "abc", "12a", "1.2.3", "1,00", " 1",
+                            "92233720368547758.08", "999999999999999999999"}) {
+        CHECK(!Money::parse(bad, amount));
+    }
+}
+
+static void testMoneyRounding() {
+    // Digits past the cents are rounded with the requested mode
+    CHECK(parsed("0.005") == cents(0));
+    CHECK(parsed("0.015") == cents(2));
+    CHECK(parsed("0.0051") == cents(1));
+    CHECK(parsed("0.005", RoundingMode::HalfAwayFromZero) == cents(1));
+    CHECK(parsed("-0.005", RoundingMode::HalfAwayFromZero) == cents(-1));
+    CHECK(parsed("1.999", RoundingMode::TowardZero) == cents(199));
+    CHECK(parsed("-1.001", RoundingMode::Floor) == cents(-101));
+    CHECK(parsed("1.001", RoundingMode::Floor) == cents(100));
+    CHECK(parsed("1.001", RoundingMode::Ceiling) == cents(101));
+    CHECK(parsed("-1.009", RoundingMode::Ceiling) == cents(-100));
+
+    CHECK(Money::fromDouble(0.125) == cents(12));
+    CHECK(Money::fromDouble(0.135) == cents(14));
+    CHECK(Money::fromDouble(0.125, RoundingMode::HalfAwayFromZero) == cents(13));
+    CHECK(cents(100000).applyRate(0.04 / 12) == cents(333));
+    CHECK(cents(150).applyRate(0.5) == cents(75));
+    CHECK(cents(125).applyRate(0.1) == cents(12));
+}
+
+static void testMoneyFormatAndOverflow() {
+    CHECK(cents(0).toString() == "0.00");
+    CHECK(cents(5).toString() == "0.05");
+    CHECK(cents(-5).toString() == "-0.05");
+    CHECK(cents(123456).toString() == "1234.56");
+    CHECK(cents(INT64_MIN).toString() == "-92233720368547758.08");
+    CHECK(cents(INT64_MIN).toString().size() == Money::maxFormattedLength);
+
+    bool threw = false;
+    try {
+        Money sum = cents(INT64_MAX) + cents(1);
+        static_cast<void>(sum);
+    } catch (const std::overflow_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    threw = false;
+    try {
+        Money::fromDouble(1e30);
+    } catch (const std::overflow_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+static void testSavingsRules() {
+    Bank bank("Test Bank");
+    CHECK(bank.openSavingsAccount("S1", "Saver", cents(50000)) == OperationStatus::Ok);
+    CHECK(bank.openSavingsAccount("S1", "Again", cents(100)) == OperationStatus::AccountExists);
+    CHECK(bank.openSavingsAccount("S2", "Negative", cents(-1)) == OperationStatus::InvalidAmount);
+    CHECK(bank.openCurrentAccount("C2", "Negative", cents(-1)) == OperationStatus::InvalidAmount);
+    CHECK(bank.findAccount("S2") == nullptr);
+    CHECK(bank.findAccount("C2") == nullptr);
+
+    // The minimum balance is 100.00
+    CHECK(bank.withdraw("S1", cents(40001)).status == OperationStatus::MinimumBalanceBreach);
+    CHECK(bank.withdraw("S1", cents(0)).status == OperationStatus::InvalidAmount);
+    CHECK(bank.withdraw("S1", cents(-100)).status == OperationStatus::InvalidAmount);
+    CHECK(bank.withdraw("NOPE", cents(100)).status == OperationStatus::AccountNotFound);
+    OperationResult result = bank.withdraw("S1", cents(40000));
+    CHECK(result.status == OperationStatus::Ok);
+    CHECK(result.balance == cents(10000));
+    CHECK(result.fee == Money());
+    CHECK(bank.withdraw("S1", cents(1)).status == OperationStatus::MinimumBalanceBreach);
+
+    CHECK(bank.deposit("S1", cents(0)).status == OperationStatus::InvalidAmount);
+    CHECK(bank.deposit("S1", cents(2500)).balance == cents(12500));
+    CHECK(bank.findAccount("S1")->getBalance() == cents(12500));
+    CHECK(bank.findAccount("S1")->getTransactionHistory().size() == 3);
+}
+
+static void testOverdraftRules() {
+    Bank bank("Test Bank");
+    CHECK(bank.openCurrentAccount("C1", "Spender", cents(10000)) == OperationStatus::Ok);
+
+    // Down to zero costs nothing
+    OperationResult result = bank.withdraw("C1", cents(10000));
+    CHECK(result.status == OperationStatus::Ok);
+    CHECK(result.fee == Money());
+    CHECK(result.balance == Money());
+
+    // Going overdrawn costs the 25.00 fee on top
+    result = bank.withdraw("C1", cents(5000));
+    CHECK(result.status == OperationStatus::Ok);
+    CHECK(result.fee == cents(2500));
+    CHECK(result.balance == cents(-7500));
+
+    // The limit of 1000.00 applies to the balance before the fee
+    CHECK(bank.withdraw("C1", cents(92501)).status == OperationStatus::OverdraftLimitExceeded);
+    result = bank.withdraw("C1", cents(92500));
+    CHECK(result.status == OperationStatus::Ok);
+    CHECK(result.balance == cents(-102500));
+    CHECK(bank.withdraw("C1", cents(1)).status == OperationStatus::OverdraftLimitExceeded);
+
+    std::vector<Transaction> history = bank.findAccount("C1")->getTransactionHistory();
+    CHECK(history.size() == 6);
+    if (history.size() == 6) {
+        CHECK(history[2].getType() == TransactionType::Withdrawal);
+        CHECK(history[2].getBalanceAfter() == cents(-5000));
+        CHECK(history[3].getType() == TransactionType::OverdraftFee);
+        CHECK(history[3].getAmount() == cents(2500));
+        CHECK(history[3].getBalanceAfter() == cents(-7500));
+    }
+}
+
+static void testTransfers() {
+    Bank bank("Test Bank");
+    bank.openSavingsAccount("S1", "Saver", cents(50000));
+    bank.openCurrentAccount("C1", "Spender", cents(10000));
+
+    CHECK(bank.transfer("S1", "S1", cents(100)) == OperationStatus::SameAccount);
+    CHECK(bank.transfer("S1", "NOPE", cents(100)) == OperationStatus::AccountNotFound);
+    CHECK(bank.transfer("NOPE", "S1", cents(100)) == OperationStatus::AccountNotFound);
+    CHECK(bank.transfer("S1", "C1", cents(0)) == OperationStatus::InvalidAmount);
+    CHECK(bank.transfer("S1", "C1", cents(40001)) == OperationStatus::MinimumBalanceBreach);
+    CHECK(bank.findAccount("S1")->getBalance() == cents(50000));
+    CHECK(bank.findAccount("C1")->getBalance() == cents(10000));
+
+    CHECK(bank.transfer("S1", "C1", cents(40000)) == OperationStatus::Ok);
+    CHECK(bank.findAccount("S1")->getBalance() == cents(10000));
+    CHECK(bank.findAccount("C1")->getBalance() == cents(50000));
+
+    // An overdrawing transfer charges the fee to the source only
+    CHECK(bank.transfer("C1", "S1", cents(60000)) == OperationStatus::Ok);
+    CHECK(bank.findAccount("C1")->getBalance() == cents(-12500));
+    CHECK(bank.findAccount("S1")->getBalance() == cents(70000));
+    CHECK(bank.transfer("C1", "S1", cents(90000)) == OperationStatus::OverdraftLimitExceeded);
+    CHECK(bank.findAccount("C1")->getBalance() == cents(-12500));
+
+    std::vector<Transaction> out = bank.findAccount("C1")->getTransactionHistory();
+    std::vector<Transaction> in = bank.findAccount("S1")->getTransactionHistory();
+    CHECK(out.size() == 4);
+    CHECK(in.size() == 3);
+    if (out.size() == 4 && in.size() == 3) {
+        CHECK(out[2].getType() == TransactionType::TransferOut);
+        CHECK(out[2].getAmount() == cents(60000));
+        CHECK(out[3].getType() == TransactionType::OverdraftFee);
+        CHECK(out[3].getAmount() == cents(2500));
+        CHECK(in[2].getType() == TransactionType::TransferIn);
+        CHECK(in[2].getAmount() == cents(60000));
+    }
+}
+
+static void testInterest() {
+    Bank bank("Test Bank");
+    bank.openSavingsAccount("S1", "Saver", cents(120000));
+    bank.openCurrentAccount("C1", "Spender", cents(120000));
+    CHECK(bank.creditMonthlyInterest() == 1);
+    CHECK(bank.findAccount("S1")->getBalance() == cents(120400));
+    CHECK(bank.findAccount("C1")->getBalance() == cents(120000));
+
+    // A credit that would overflow throws before anything in its chunk is
+    // credited, and leaves no account locked
+    bank.openSavingsAccount("S2", "Rich", cents(INT64_MAX - 100));
+    bool threw = false;
+    try {
+        bank.creditMonthlyInterest();
+    } catch (const std::overflow_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(bank.findAccount("S1")->getBalance() == cents(120400));
+    CHECK(bank.deposit("S1", cents(100)).status == OperationStatus::Ok);
+    CHECK(bank.withdraw("S2", cents(100)).status == OperationStatus::Ok);
+}
+
+static void testLedgerReserve() {
+    Ledger ledger;
+    uint64_t first = ledger.reserve(3);
+    CHECK(first == 0);
+    bool threw = false;
+    try {
+        ledger.reserve(UINT64_MAX / 2);
+    } catch (const std::length_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    // The failed reservation took nothing
+    CHECK(ledger.size() == 3);
+    CHECK(ledger.reserve(1) == 3);
+}
+
+static void testAccountIndexGrowth() {
+    Bank bank("Test Bank");
+    std::vector<std::string> numbers;
+    for (int i = 0; i < 5000; ++i) {
+        numbers.push_back("IX" + std::to_string(i));
+        bank.openCurrentAccount(numbers.back(), "Holder", Money());
+    }
+    
+    // Readers probe the index while it grows through many tables
+    AccountIndex index;
+    std::atomic<size_t> inserted{0};
+    std::atomic<bool> done{false};
+    std::atomic<bool> mismatch{false};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&, r]() {
+            for (size_t i = size_t(r); !done.load(std::memory_order_acquire); ++i) {
+                size_t visible = inserted.load(std::memory_order_acquire);
+                if (visible == 0) continue;
+                const std::string& number = numbers[i % visible];
+                if (index.find(number) != bank.findAccount(number)) mismatch = true;
+            }
+        });
+    }
+    bool allInserted = true;
+    for (const std::string& number : numbers) {
+        allInserted &= index.insert(bank.findAccount(number));
+        inserted.store(inserted.load() + 1, std::memory_order_release);
+    }
+    CHECK(allInserted);
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    CHECK(!mismatch);
+    
+    // With the readers gone nothing holds a retired table
+    index.releaseRetiredTables();
+    CHECK(index.retiredTables() == 0);
+    CHECK(index.size() == numbers.size());
+    CHECK(index.find("IX4999") == bank.findAccount("IX4999"));
+    CHECK(!index.insert(bank.findAccount("IX0")));
+}
+
+struct AccountState {
+    Money balance;
+    std::vector<Transaction> history;
+};
+
+static std::vector<AccountState> captureState(Bank& bank,
+                                              const std::vector<std::string>& numbers) {
+    std::vector<AccountState> states;
+    for (const std::string& number : numbers) {
+        const Account* account = bank.findAccount(number);
+        CHECK(account != nullptr);
+        if (account) states.push_back(AccountState{account->getBalance(),
+                                                   account->getTransactionHistory()});
+    }
+    return states;
+}
+
+static bool sameState(const std::vector<AccountState>& a, const std::vector<AccountState>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].balance != b[i].balance || a[i].history.size() != b[i].history.size()) return false;
+        for (size_t t = 0; t < a[i].history.size(); ++t) {
+            const Transaction& x = a[i].history[t];
+            const Transaction& y = b[i].history[t];
+            if (x.getType() != y.getType() || x.getAmount() != y.getAmount() ||
+                x.getBalanceAfter() != y.getBalanceAfter()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Runs some business on a durable bank in dir; with checkpointHalfway the
+// first half ends up in the snapshot and the rest in the log
+static void runDurableBusiness(Bank& bank, bool checkpointHalfway) {
+    CHECK(bank.openSavingsAccount("S1", "Saver", cents(100000)) == OperationStatus::Ok);
+    CHECK(bank.openSavingsAccount("S2", "Other Saver", cents(20000)) == OperationStatus::Ok);
+    CHECK(bank.openCurrentAccount("C1", "Spender", cents(5000)) == OperationStatus::Ok);
+    CHECK(bank.withdraw("C1", cents(7000)).fee == cents(2500));
+    CHECK(bank.transfer("S1", "C1", cents(30000)) == OperationStatus::Ok);
+    CHECK(bank.creditMonthlyInterest() == 2);
+    if (checkpointHalfway) CHECK(bank.checkpoint());
+
+    ProductParameters parameters = bank.getProducts().find(Bank::savingsProductId)->getParameters();
+    parameters.interestRate = 0.12;
+    CHECK(bank.setProductParameters(Bank::savingsProductId, parameters));
+    CHECK(bank.openCurrentAccount("C2", "Late", Money()) == OperationStatus::Ok);
+    CHECK(bank.transfer("C2", "S2", cents(10000)) == OperationStatus::Ok);
+    CHECK(bank.deposit("S1", cents(1234)).status == OperationStatus::Ok);
+    CHECK(bank.creditMonthlyInterest() == 2);
+}
+
+static void testRecoveryRoundTrip(bool checkpointHalfway) {
+    std::string dir = makeTempDirectory();
+    std::vector<std::string> numbers = {"S1", "S2", "C1", "C2"};
+    std::vector<AccountState> before;
+    {
+        Bank bank("Test Bank");
+        RecoveryStats stats = bank.openDataDirectory(dir);
+        CHECK(stats.ok);
+        CHECK(!stats.snapshotLoaded);
+        runDurableBusiness(bank, checkpointHalfway);
+        before = captureState(bank, numbers);
+    }
+    {
+        Bank bank("Test Bank");
+        RecoveryStats stats = bank.openDataDirectory(dir);
+        CHECK(stats.ok);
+        CHECK(stats.snapshotLoaded == checkpointHalfway);
+        CHECK(stats.replayedRecords > 0);
+        CHECK(bank.getAccountCount() == numbers.size());
+        CHECK(sameState(before, captureState(bank, numbers)));
+        CHECK(bank.getProducts().find(Bank::savingsProductId)->getInterestRate() == 0.12);
+
+        // The recovered bank carries on: a checkpoint and another restart
+        // give the same state again
+        CHECK(bank.withdraw("C2", cents(100)).fee == cents(2500));
+        before = captureState(bank, numbers);
+        CHECK(bank.checkpoint());
+    }
+    {
+        Bank bank("Test Bank");
+        RecoveryStats stats = bank.openDataDirectory(dir);
+        CHECK(stats.ok);
+        CHECK(stats.snapshotLoaded);
+        CHECK(sameState(before, captureState(bank, numbers)));
+        CHECK(bank.openSavingsAccount("S1", "Again", Money()) == OperationStatus::AccountExists);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+static void testRecoveryRejectsCorruptSnapshot() {
+    std::string dir = makeTempDirectory();
+    {
+        Bank bank("Test Bank");
+        CHECK(bank.openDataDirectory(dir).ok);
+        bank.openSavingsAccount("S1", "Saver", cents(100000));
+        CHECK(bank.checkpoint());
+    }
+    std::filesystem::resize_file(dir + "/bank.snapshot",
+                                 std::filesystem::file_size(dir + "/bank.snapshot") - 4);
+    Bank bank("Test Bank");
+    RecoveryStats stats = bank.openDataDirectory(dir);
+    CHECK(!stats.ok);
+    CHECK(!stats.error.empty());
+    std::filesystem::remove_all(dir);
+}
+
+// Overwrites one length field of a snapshot with a huge value; recovery
+// must fail cleanly rather than try to allocate for it
+static void testRecoveryRejectsHugeSnapshotCounts() {
+    std::string dir = makeTempDirectory();
+    {
+        Bank bank("Test Bank");
+        CHECK(bank.openDataDirectory(dir).ok);
+        bank.openSavingsAccount("S1", "Saver", cents(100000));
+        bank.deposit("S1", cents(500));
+        CHECK(bank.checkpoint());
+    }
+    std::string path = dir + "/bank.snapshot";
+    std::string original;
+    {
+        std::ifstream in(path, std::ios::binary);
+        original.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto readU64 = [&](size_t offset) {
+        uint64_t value = 0;
+        std::memcpy(&value, original.data() + offset, sizeof(value));
+        return value;
+    };
+    // magic, lsn, account count, product count, product table size
+    const size_t accountCountOffset = 16;
+    const size_t tableBytesOffset = 28;
+    size_t blockOffset = 36 + size_t(readU64(tableBytesOffset));
+    size_t blockBytesOffset = blockOffset + 4;
+    size_t ledgerCountOffset = blockOffset + 12 + size_t(readU64(blockBytesOffset));
+    CHECK(ledgerCountOffset + 8 < original.size());
+    CHECK(readU64(ledgerCountOffset) == 2);
+    
+    for (size_t offset : {accountCountOffset, tableBytesOffset, blockBytesOffset, ledgerCountOffset}) {
+        std::string corrupt = original;
+        uint64_t huge = uint64_t(1) << 60;
+        std::memcpy(&corrupt[offset], &huge, sizeof(huge));
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(corrupt.data(), std::streamsize(corrupt.size()));
+        }
+        Bank bank("Test Bank");
+        RecoveryStats stats = bank.openDataDirectory(dir);
+        CHECK(!stats.ok);
+        CHECK(!stats.error.empty());
+    }
+    std::filesystem::remove_all(dir);
+}
+
+int main() {
+    testMoneyParse();
+    testMoneyRounding();
+    testMoneyFormatAndOverflow();
+    testSavingsRules();
+    testOverdraftRules();
+    testTransfers();
+    testInterest();
+    testLedgerReserve();
+    testAccountIndexGrowth();
+    testRecoveryRoundTrip(false);
+    testRecoveryRoundTrip(true);
+    testRecoveryRejectsCorruptSnapshot();
+    testRecoveryRejectsHugeSnapshotCounts();
+
+    std::cout << checksRun << " checks, " << checksFailed << " failed" << std::endl;
+    return checksFailed == 0 ? 0 : 1;
+}
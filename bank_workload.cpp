@@ -0,0 +1,137 @@
+// Writes a synthetic workload as script commands for the non-interactive
+// mode: the account openings, then the operation stream. With --paced the
+// operations are written at their generated arrival times, so bursts and
+// idle gaps reach the bank as they would from real clients.
+//
+// Build: cmake --preset release && cmake --build --preset release
+// Usage: bank_workload [--seed N] [--savings N] [--current N] [--operations N]
+//                      [--zipf THETA] [--mix B,D,W,T] [--burst-length N]
+//                      [--burst-rate OPS] [--idle-us N] [--paced]
+// Example: bank_workload --operations 1000000 | banking_system --script -
+
+#include "bank_workload.h"
+#include <sstream>
+
+struct WorkloadOptions {
+    WorkloadSpec spec;
+    uint64_t operations = 100000;
+    bool paced = false;
+};
+
+static bool parseMix(const std::string& text, unsigned mix[4]) {
+    std::stringstream in(text);
+    std::string item;
+    unsigned total = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (!std::getline(in, item, ',') || item.empty() ||
+            item.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        mix[i] = static_cast<unsigned>(std::stoul(item));
+        total += mix[i];
+    }
+    return !std::getline(in, item) && total == 100;
+}
+
+static bool writeAll(const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(STDOUT_FILENO, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        written += size_t(n);
+    }
+    return true;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--seed N] [--savings N] [--current N] [--operations N]\n"
+              << "       [--zipf THETA] [--mix B,D,W,T] [--burst-length N] [--burst-rate OPS]\n"
+              << "       [--idle-us N] [--paced]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    WorkloadOptions options;
+    WorkloadSpec& spec = options.spec;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            spec.seed = std::stoull(argv[++i]);
+        } else if (arg == "--savings" && i + 1 < argc) {
+            spec.savingsAccounts = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--current" && i + 1 < argc) {
+            spec.currentAccounts = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--operations" && i + 1 < argc) {
+            options.operations = std::stoull(argv[++i]);
+        } else if (arg == "--zipf" && i + 1 < argc) {
+            spec.zipfTheta = std::stod(argv[++i]);
+            if (spec.zipfTheta < 0 || spec.zipfTheta >= 1) {
+                std::cerr << "--zipf needs a skew in [0, 1)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--mix" && i + 1 < argc) {
+            if (!parseMix(argv[++i], spec.mix)) {
+                std::cerr << "--mix needs four comma-separated percentages adding up to 100" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--burst-length" && i + 1 < argc) {
+            spec.meanBurstLength = std::max(1.0, std::stod(argv[++i]));
+        } else if (arg == "--burst-rate" && i + 1 < argc) {
+            spec.burstRate = std::max(1.0, std::stod(argv[++i]));
+        } else if (arg == "--idle-us" && i + 1 < argc) {
+            spec.meanIdleMicros = std::max(0.0, std::stod(argv[++i]));
+        } else if (arg == "--paced") {
+            options.paced = true;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (uint64_t(spec.savingsAccounts) + spec.currentAccounts == 0 ||
+        uint64_t(spec.savingsAccounts) + spec.currentAccounts > UINT32_MAX) {
+        std::cerr << "The workload needs between 1 and 2^32 - 1 accounts" << std::endl;
+        return 1;
+    }
+
+    WorkloadGenerator generator(spec);
+    std::vector<WorkloadAccount> accounts = generator.generateAccounts();
+    std::string out;
+    out.reserve(1 << 17);
+    for (const auto& account : accounts) {
+        appendScriptAccount(out, account);
+        if (out.size() >= (1 << 16)) {
+            if (!writeAll(out)) return 1;
+            out.clear();
+        }
+    }
+
+    // Unpaced output is written in large blocks; paced output is written
+    // whenever the next operation is due later than now
+    auto start = std::chrono::steady_clock::now();
+    std::vector<WorkloadOperation> burst;
+    uint64_t generated = 0;
+    while (generated < options.operations) {
+        burst.clear();
+        generator.nextBurst(burst);
+        if (burst.size() > options.operations - generated) {
+            burst.resize(options.operations - generated);
+        }
+        generated += burst.size();
+        for (const auto& operation : burst) {
+            if (options.paced) {
+                auto due = start + std::chrono::nanoseconds(operation.arrivalNanos);
+                if (due > std::chrono::steady_clock::now()) {
+                    if (!writeAll(out)) return 1;
+                    out.clear();
+                    std::this_thread::sleep_until(due);
+                }
+            }
+            appendScriptCommand(out, operation, accounts);
+            if (out.size() >= (1 << 16)) {
+                if (!writeAll(out)) return 1;
+                out.clear();
+            }
+        }
+    }
+    return writeAll(out) ? 0 : 1;
+}
@@ -0,0 +1,320 @@
+#ifndef BANK_WORKLOAD_H
+#define BANK_WORKLOAD_H
+
+// Deterministic synthetic workloads for the bank. A WorkloadSpec and its
+// seed fully determine the accounts (savings and current, with log-normal
+// opening balances) and the operation stream: Zipfian account popularity,
+// a configurable mix of balance reads, deposits, withdrawals and transfers,
+// and bursty arrival times. The same stream can be applied through
+// Bank::applyBatch or written out as script commands.
+//
+// Random numbers come from xoshiro256** and the distributions are computed
+// here rather than with <random>, whose distributions differ between
+// standard libraries, so a seed gives the same stream with any of them.
+
+#include "banking_core.h"
+#include <cmath>
+
+// xoshiro256** seeded through splitmix64
+class Xoshiro256 {
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    explicit Xoshiro256(uint64_t seed) {
+        for (auto& word : s) {
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, 1)
+    double uniform() { return double(next() >> 11) * 0x1.0p-53; }
+
+    // Uniform in [0, bound)
+    uint64_t below(uint64_t bound) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * bound) >> 64);
+    }
+
+    double exponential(double mean) { return -mean * std::log1p(-uniform()); }
+
+    // Box-Muller; the second value of each pair is discarded so every call
+    // consumes exactly two uniforms
+    double normal() {
+        double u1 = 1.0 - uniform();
+        double u2 = uniform();
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+    }
+
+    // Log-normal with the given median; sigma is the spread of the log
+    double logNormal(double median, double sigma) { return median * std::exp(sigma * normal()); }
+};
+
+// Zipfian ranks in [0, n), rank 0 the most popular, after Gray et al.,
+// "Quickly Generating Billion-Record Synthetic Databases" (the generator
+// YCSB uses). theta must be in [0, 1); 0 is uniform and 0.99 is the usual
+// "hot set" skew. Construction is O(n), sampling O(1).
+class ZipfianDistribution {
+private:
+    uint64_t n;
+    double theta;
+    double alpha = 0;
+    double zetan = 0;
+    double eta = 0;
+    double halfPowTheta = 0;
+
+    static double zeta(uint64_t count, double theta) {
+        double sum = 0;
+        for (uint64_t i = 1; i <= count; ++i) {
+            sum += 1.0 / std::pow(double(i), theta);
+        }
+        return sum;
+    }
+
+public:
+    ZipfianDistribution(uint64_t count, double skew) : n(std::max<uint64_t>(1, count)), theta(skew) {
+        if (theta <= 0) return;
+        zetan = zeta(n, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / double(n), 1.0 - theta)) / (1.0 - zeta(2, theta) / zetan);
+        halfPowTheta = std::pow(0.5, theta);
+    }
+
+    uint64_t operator()(Xoshiro256& random) const {
+        if (theta <= 0) return random.below(n);
+        double u = random.uniform();
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + halfPowTheta) return std::min<uint64_t>(1, n - 1);
+        uint64_t rank = static_cast<uint64_t>(double(n) * std::pow(eta * u - eta + 1.0, alpha));
+        return std::min(rank, n - 1);
+    }
+};
+
+enum class WorkloadOperationType : uint8_t {
+    Balance,
+    Deposit,
+    Withdraw,
+    Transfer
+};
+
+// One generated operation. Accounts are indexes into the account list;
+// arrivalNanos is the offset from the start of the stream.
+struct WorkloadOperation {
+    WorkloadOperationType type;
+    uint32_t account;
+    uint32_t counterpart;    // transfer destination
+    Money amount;
+    int64_t arrivalNanos;
+};
+
+struct WorkloadAccount {
+    std::string accountNumber;
+    std::string holderName;
+    bool savings;
+    Money openingBalance;
+};
+
+struct WorkloadSpec {
+    uint64_t seed = 1;
+    uint32_t savingsAccounts = 1000;
+    uint32_t currentAccounts = 1000;
+    double zipfTheta = 0.99;
+    // Percentages of balance reads, deposits, withdrawals and transfers
+    unsigned mix[4] = {60, 20, 15, 5};
+    // Operations arrive in bursts of geometrically distributed length at
+    // burstRate per second, separated by exponentially distributed idle gaps
+    double meanBurstLength = 64;
+    double burstRate = 1e6;
+    double meanIdleMicros = 1000;
+};
+
+class WorkloadGenerator {
+private:
+    WorkloadSpec spec;
+    Xoshiro256 random;
+    ZipfianDistribution popularity;
+    // Popularity rank -> account index, so the hot accounts are spread over
+    // both account types instead of being the first ones created
+    std::vector<uint32_t> rankToAccount;
+    double clockNanos = 0;
+    bool burstEnded = true;   // the next operation starts a new burst
+
+    uint32_t accountCount() const { return spec.savingsAccounts + spec.currentAccounts; }
+
+    uint32_t pickAccount() { return rankToAccount[popularity(random)]; }
+
+    static Money roundedAmount(double dollars) {
+        return std::max(Money::fromCents(1), Money::fromDouble(dollars));
+    }
+
+    // The first operation of a burst follows an idle gap, the rest follow
+    // each other at the burst rate. Each operation ends its burst with
+    // probability 1 / meanBurstLength.
+    void advanceClock() {
+        if (burstEnded) {
+            clockNanos += random.exponential(spec.meanIdleMicros * 1000.0);
+        } else {
+            clockNanos += random.exponential(1e9 / spec.burstRate);
+        }
+        burstEnded = random.uniform() * spec.meanBurstLength < 1.0;
+    }
+
+public:
+    explicit WorkloadGenerator(const WorkloadSpec& workloadSpec)
+        : spec(workloadSpec), random(workloadSpec.seed),
+          popularity(uint64_t(workloadSpec.savingsAccounts) + workloadSpec.currentAccounts,
+                     workloadSpec.zipfTheta) {
+        rankToAccount.resize(std::max(1u, accountCount()));
+        for (uint32_t i = 0; i < rankToAccount.size(); ++i) {
+            rankToAccount[i] = i;
+        }
+        for (size_t i = rankToAccount.size(); i > 1; --i) {
+            std::swap(rankToAccount[i - 1], rankToAccount[random.below(i)]);
+        }
+    }
+
+    const WorkloadSpec& getSpec() const { return spec; }
+
+    static std::string accountNumber(uint32_t index) {
+        return "WL" + std::to_string(index);
+    }
+
+    // Savings accounts first, then current accounts. Drawn from a stream of
+    // their own so the account list does not depend on how many operations
+    // have been generated.
+    std::vector<WorkloadAccount> generateAccounts() const {
+        static const char* const firstNames[] = {
+            "Alice", "Bob", "Carmen", "Deepak", "Elena", "Farid", "Grace", "Hiro",
+            "Ines", "Jonas", "Kemi", "Luca", "Maya", "Nikolai", "Olga", "Priya"
+        };
+        static const char* const lastNames[] = {
+            "Smith", "Garcia", "Chen", "Okafor", "Novak", "Haddad", "Kim", "Rossi",
+            "Silva", "Muller", "Tanaka", "Singh", "Larsen", "Dubois", "Ivanova", "Park"
+        };
+        Xoshiro256 accountRandom(spec.seed ^ 0xA5A5A5A5DEADBEEFull);
+        std::vector<WorkloadAccount> accounts;
+        accounts.reserve(accountCount());
+        for (uint32_t i = 0; i < accountCount(); ++i) {
+            bool savings = i < spec.savingsAccounts;
+            std::string holder = std::string(firstNames[accountRandom.below(16)]) + " " +
+                                 lastNames[accountRandom.below(16)];
+            // Savings balances centre on 5000 and never start below the
+            // minimum balance; current accounts centre on 1500
+            Money opening = savings
+                ? std::max(SavingsAccount::defaultMinimumBalance,
+                           roundedAmount(accountRandom.logNormal(5000.0, 1.0)))
+                : roundedAmount(accountRandom.logNormal(1500.0, 0.9));
+            accounts.push_back(WorkloadAccount{accountNumber(i), std::move(holder), savings, opening});
+        }
+        return accounts;
+    }
+
+    WorkloadOperation next() {
+        advanceClock();
+        WorkloadOperation operation{WorkloadOperationType::Balance, pickAccount(), 0, Money(),
+                                    static_cast<int64_t>(clockNanos)};
+        uint64_t roll = random.below(100);
+        if (roll < spec.mix[0]) {
+            return operation;
+        }
+        if (roll < spec.mix[0] + spec.mix[1]) {
+            operation.type = WorkloadOperationType::Deposit;
+            operation.amount = roundedAmount(random.logNormal(50.0, 1.2));
+        } else if (roll < spec.mix[0] + spec.mix[1] + spec.mix[2]) {
+            operation.type = WorkloadOperationType::Withdraw;
+            operation.amount = roundedAmount(random.logNormal(40.0, 1.0));
+        } else {
+            operation.type = WorkloadOperationType::Transfer;
+            operation.counterpart = pickAccount();
+            if (operation.counterpart == operation.account && accountCount() > 1) {
+                operation.counterpart = (operation.account + 1) % accountCount();
+            }
+            operation.amount = roundedAmount(random.logNormal(100.0, 1.0));
+        }
+        return operation;
+    }
+
+    // Appends operations up to and including the end of the current burst
+    void nextBurst(std::vector<WorkloadOperation>& out) {
+        do {
+            out.push_back(next());
+        } while (!burstEnded);
+    }
+};
+
+// Opens every account without waiting for durability
+inline void openWorkloadAccounts(Bank& bank, const std::vector<WorkloadAccount>& accounts) {
+    for (const auto& account : accounts) {
+        if (account.savings) {
+            bank.openSavingsAccount(account.accountNumber, account.holderName, account.openingBalance);
+        } else {
+            bank.openCurrentAccount(account.accountNumber, account.holderName, account.openingBalance);
+        }
+    }
+}
+
+// Converts the deposits and withdrawals of a stream into applyBatch input.
+// The batch API has no reads or transfers, so those are skipped; generate
+// with a mix of 0,D,W,0 to feed it without losing operations.
+inline void appendBatchOperations(std::span<const WorkloadOperation> operations,
+                                  const std::vector<WorkloadAccount>& accounts,
+                                  std::vector<BatchOperation>& out) {
+    for (const auto& operation : operations) {
+        if (operation.type == WorkloadOperationType::Deposit) {
+            out.push_back(BatchOperation{OperationType::Deposit,
+                                         accounts[operation.account].accountNumber, operation.amount});
+        } else if (operation.type == WorkloadOperationType::Withdraw) {
+            out.push_back(BatchOperation{OperationType::Withdraw,
+                                         accounts[operation.account].accountNumber, operation.amount});
+        }
+    }
+}
+
+// Script command lines for the non-interactive mode (banking_system --script)
+inline void appendScriptAccount(std::string& out, const WorkloadAccount& account) {
+    char amount[Money::maxFormattedLength];
+    out += account.savings ? "S " : "C ";
+    out += account.accountNumber;
+    out += ' ';
+    out.append(amount, account.openingBalance.format(amount));
+    out += ' ';
+    out += account.holderName;
+    out += '\n';
+}
+
+inline void appendScriptCommand(std::string& out, const WorkloadOperation& operation,
+                                const std::vector<WorkloadAccount>& accounts) {
+    static const char codes[] = {'B', 'D', 'W', 'T'};
+    char amount[Money::maxFormattedLength];
+    out += codes[static_cast<size_t>(operation.type)];
+    out += ' ';
+    out += accounts[operation.account].accountNumber;
+    if (operation.type == WorkloadOperationType::Transfer) {
+        out += ' ';
+        out += accounts[operation.counterpart].accountNumber;
+    }
+    if (operation.type != WorkloadOperationType::Balance) {
+        out += ' ';
+        out.append(amount, operation.amount.format(amount));
+    }
+    out += '\n';
+}
+
+#endif
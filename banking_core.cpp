@@ -0,0 +1,748 @@
+// Out-of-line parts of the banking core: Money's overflow errors, the
+// process-wide fence, the write-ahead log's file handling, snapshots and recovery, exports,
+// metrics output and the activity log's writer thread. The per-operation
+// paths stay inline in banking_core.h.
+
+#include "banking_core.h"
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#endif
+
+void Money::throwOverflow(const char* what) {
+    throw std::overflow_error(what);
+}
+
+bool AsymmetricFence::registerExpedited() {
+#if defined(__linux__) && defined(__NR_membarrier)
+    return syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+void AsymmetricFence::heavy() {
+#if defined(__linux__) && defined(__NR_membarrier)
+    if (expedited && syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0) == 0) {
+        return;
+    }
+#endif
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+uint32_t crc32(const char* data, size_t length, uint32_t crc) {
+    static const auto table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void WriteAheadLog::flushLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (pendingRecords == 0) {
+            if (stopping) return;
+            flushNeeded.wait(lock, [this]() { return stopping || pendingRecords > 0; });
+            continue;
+        }
+        if (policy.maxDelay.count() > 0 && pendingRecords < policy.maxBatch && !stopping) {
+            flushNeeded.wait_until(lock, oldestPending + policy.maxDelay, [this]() {
+                return stopping || pendingRecords >= policy.maxBatch;
+            });
+        }
+        
+        std::string batch;
+        batch.swap(buffer);
+        uint64_t batchLsn = appendedLsn;
+        pendingRecords = 0;
+        lock.unlock();
+        bool written = writeAll(batch.data(), batch.size()) && fdatasync(fd) == 0;
+        lock.lock();
+        if (written) {
+            durableLsn = batchLsn;
+        } else {
+            failed = true;
+        }
+        flushed.notify_all();
+    }
+}
+
+bool WriteAheadLog::writeAll(const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = ::write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= size_t(n);
+    }
+    return true;
+}
+
+WriteAheadLog::Tail WriteAheadLog::scan(const std::string& path, const RecordHandler& handler) {
+    Tail tail;
+    std::ifstream in(path, std::ios::binary);
+    char header[sizeof(magic)];
+    if (!in.read(header, sizeof(magic)) || std::memcmp(header, magic, sizeof(magic)) != 0) {
+        return tail;
+    }
+    tail.validEnd = sizeof(magic);
+    std::string frame;
+    char fixed[8];
+    while (in.read(fixed, 8)) {
+        uint32_t length, checksum;
+        std::memcpy(&length, fixed, 4);
+        std::memcpy(&checksum, fixed + 4, 4);
+        frame.resize(9 + size_t(length));
+        if (!in.read(&frame[0], frame.size())) break;
+        if (crc32(frame.data(), frame.size()) != checksum) break;
+        
+        uint64_t lsn;
+        std::memcpy(&lsn, frame.data(), 8);
+        ByteReader payload(frame.data() + 9, length);
+        handler(lsn, static_cast<WalRecordType>(frame[8]), payload);
+        tail.validEnd += 8 + frame.size();
+        tail.lastLsn = lsn;
+    }
+    return tail;
+}
+
+bool WriteAheadLog::open(const std::string& path, GroupCommitPolicy commitPolicy,
+                         uint64_t minLsn) {
+    close();
+    Tail tail = scan(path, [](uint64_t, WalRecordType, ByteReader&) {});
+    return open(path, commitPolicy, minLsn, tail);
+}
+
+bool WriteAheadLog::open(const std::string& path, GroupCommitPolicy commitPolicy,
+                         uint64_t minLsn, const Tail& tail) {
+    close();
+    uint64_t validEnd = tail.validEnd;
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) return false;
+    if (validEnd == 0) {
+        if (ftruncate(fd, 0) != 0 || !writeAll(magic, sizeof(magic)) || fdatasync(fd) != 0) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        validEnd = sizeof(magic);
+    } else if (ftruncate(fd, off_t(validEnd)) != 0) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    lseek(fd, off_t(validEnd), SEEK_SET);
+    
+    policy = commitPolicy;
+    policy.maxBatch = std::max<size_t>(1, policy.maxBatch);
+    appendedLsn = durableLsn = std::max(tail.lastLsn, minLsn);
+    stopping = failed = false;
+    flusher = std::thread(&WriteAheadLog::flushLoop, this);
+    return true;
+}
+
+void WriteAheadLog::close() {
+    if (fd < 0) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    flushNeeded.notify_one();
+    flusher.join();
+    ::close(fd);
+    fd = -1;
+}
+
+bool WriteAheadLog::reset() {
+    std::unique_lock<std::mutex> lock(mutex);
+    flushed.wait(lock, [this]() { return durableLsn >= appendedLsn || failed; });
+    if (failed) return false;
+    if (ftruncate(fd, off_t(sizeof(magic))) != 0 || fdatasync(fd) != 0) return false;
+    return lseek(fd, off_t(sizeof(magic)), SEEK_SET) >= 0;
+}
+
+void Ledger::writeTo(std::ostream& out) const {
+    uint64_t count = size();
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (uint64_t base = 0; base < count; base += segmentSize) {
+        const Segment& segment = segmentOf(base);
+        size_t n = size_t(std::min(segmentSize, count - base));
+        out.write(reinterpret_cast<const char*>(segment.accountIds), n * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(segment.types), n * sizeof(TransactionType));
+        out.write(reinterpret_cast<const char*>(segment.amounts), n * sizeof(int64_t));
+        out.write(reinterpret_cast<const char*>(segment.balancesAfter), n * sizeof(int64_t));
+        out.write(reinterpret_cast<const char*>(segment.timestamps), n * sizeof(int64_t));
+        out.write(reinterpret_cast<const char*>(segment.previous), n * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(segment.links), n * sizeof(uint64_t));
+    }
+}
+
+// Bytes from the read position to the end of a seekable stream, zero if
+// either is unknown. Counts read from a file are checked against it before
+// they size anything, so a corrupt one fails instead of allocating.
+static uint64_t remainingBytes(std::istream& in) {
+    std::streampos position = in.tellg();
+    if (position < 0 || !in.seekg(0, std::ios::end)) return 0;
+    std::streampos end = in.tellg();
+    in.seekg(position);
+    return end > position ? uint64_t(end - position) : 0;
+}
+
+bool Ledger::readFrom(std::istream& in) {
+    constexpr uint64_t savedEntryBytes = sizeof(uint32_t) + sizeof(TransactionType) + 
+                                         5 * sizeof(int64_t);
+    uint64_t saved = 0;
+    if (!in.read(reinterpret_cast<char*>(&saved), sizeof(saved)) || 
+        saved > remainingBytes(in) / savedEntryBytes) {
+        return false;
+    }
+    clear();
+    reserve(saved);
+    for (uint64_t base = 0; base < saved; base += segmentSize) {
+        Segment& segment = segmentOf(base);
+        size_t n = size_t(std::min(segmentSize, saved - base));
+        in.read(reinterpret_cast<char*>(segment.accountIds), n * sizeof(uint32_t));
+        in.read(reinterpret_cast<char*>(segment.types), n * sizeof(TransactionType));
+        in.read(reinterpret_cast<char*>(segment.amounts), n * sizeof(int64_t));
+        in.read(reinterpret_cast<char*>(segment.balancesAfter), n * sizeof(int64_t));
+        in.read(reinterpret_cast<char*>(segment.timestamps), n * sizeof(int64_t));
+        in.read(reinterpret_cast<char*>(segment.previous), n * sizeof(uint64_t));
+        in.read(reinterpret_cast<char*>(segment.links), n * sizeof(uint64_t));
+    }
+    return static_cast<bool>(in);
+}
+
+void Ledger::exportCsv(std::ostream& out) const {
+    out << "entry,account_id,type,amount,balance_after,timestamp_ns,linked_entry\n";
+    uint64_t count = size();
+    for (uint64_t base = 0; base < count; base += segmentSize) {
+        const Segment& segment = segmentOf(base);
+        uint64_t end = std::min(segmentSize, count - base);
+        for (uint64_t i = 0; i < end; ++i) {
+            out << (base + i) << ',' << segment.accountIds[i] << ','
+                << transactionTypeName(segment.types[i]) << ','
+                << Money::fromCents(segment.amounts[i]) << ','
+                << Money::fromCents(segment.balancesAfter[i]) << ','
+                << segment.timestamps[i] << ',';
+            if (segment.links[i] != npos) out << segment.links[i];
+            out << '\n';
+        }
+    }
+}
+
+LatencyHistogram BankMetrics::histogram(MetricOperation operation) const {
+    size_t op = static_cast<size_t>(operation);
+    LatencyHistogram merged;
+    shards.forEach([&](const Shard& shard) {
+        for (size_t i = 0; i < LatencyHistogram::bucketCount; ++i) {
+            uint64_t count = shard.buckets[op][i].load(std::memory_order_relaxed);
+            if (count) merged.add(i, count);
+        }
+        merged.addSum(shard.sumNanos[op].load(std::memory_order_relaxed));
+    });
+    return merged;
+}
+
+uint64_t BankMetrics::outcomeCount(MetricOperation operation, OperationStatus status) const {
+    uint64_t count = 0;
+    shards.forEach([&](const Shard& shard) {
+        count += shard.outcomes[static_cast<size_t>(operation)][static_cast<size_t>(status)]
+                     .load(std::memory_order_relaxed);
+    });
+    return count;
+}
+
+void BankMetrics::writePrometheus(std::ostream& out) const {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    char line[192];
+    LatencyHistogram histograms[metricOperationCount];
+    for (size_t op = 0; op < metricOperationCount; ++op) {
+        histograms[op] = histogram(static_cast<MetricOperation>(op));
+    }
+    
+    out << "# HELP bank_operation_duration_seconds Time spent in bank operations.\n"
+        << "# TYPE bank_operation_duration_seconds histogram\n";
+    for (size_t op = 0; op < metricOperationCount; ++op) {
+        const char* name = metricOperationName(static_cast<MetricOperation>(op));
+        const LatencyHistogram& h = histograms[op];
+        for (unsigned exponent = 6; exponent <= 36; exponent += 2) {
+            uint64_t limit = uint64_t(1) << exponent;
+            std::snprintf(line, sizeof(line), 
+                          "bank_operation_duration_seconds_bucket{operation=\"%s\",le=\"%.9g\"} %" PRIu64 "\n",
+                          name, double(limit) * 1e-9, h.countBelow(limit));
+            out << line;
+        }
+        std::snprintf(line, sizeof(line),
+                      "bank_operation_duration_seconds_bucket{operation=\"%s\",le=\"+Inf\"} %" PRIu64 "\n",
+                      name, h.getCount());
+        out << line;
+        std::snprintf(line, sizeof(line), "bank_operation_duration_seconds_sum{operation=\"%s\"} %.9g\n",
+                      name, double(h.getSumNanos()) * 1e-9);
+        out << line;
+        std::snprintf(line, sizeof(line), 
+                      "bank_operation_duration_seconds_count{operation=\"%s\"} %" PRIu64 "\n",
+                      name, h.getCount());
+        out << line;
+    }
+    
+    out << "# HELP bank_operation_duration_quantile_seconds Latency quantiles from the histogram, within 6.25%.\n"
+        << "# TYPE bank_operation_duration_quantile_seconds gauge\n";
+    for (size_t op = 0; op < metricOperationCount; ++op) {
+        const char* name = metricOperationName(static_cast<MetricOperation>(op));
+        for (double q : quantiles) {
+            std::snprintf(line, sizeof(line),
+                          "bank_operation_duration_quantile_seconds{operation=\"%s\",quantile=\"%g\"} %.9g\n",
+                          name, q, double(histograms[op].valueAtQuantile(q)) * 1e-9);
+            out << line;
+        }
+    }
+    
+    out << "# HELP bank_operations_total Bank operations by outcome.\n"
+        << "# TYPE bank_operations_total counter\n";
+    for (size_t op = 0; op < metricOperationCount; ++op) {
+        for (size_t status = 0; status < operationStatusCount; ++status) {
+            uint64_t count = outcomeCount(static_cast<MetricOperation>(op), 
+                                          static_cast<OperationStatus>(status));
+            if (count == 0 && status != 0) continue;
+            std::snprintf(line, sizeof(line), 
+                          "bank_operations_total{operation=\"%s\",status=\"%s\"} %" PRIu64 "\n",
+                          metricOperationName(static_cast<MetricOperation>(op)),
+                          operationStatusName(static_cast<OperationStatus>(status)), count);
+            out << line;
+        }
+    }
+}
+
+bool BankMetrics::writePrometheusFile(const std::string& path) const {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out) return false;
+        writePrometheus(out);
+        out.flush();
+        if (!out) return false;
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void Bank::creditMonthlyInterestLocked() {
+    int64_t start = metrics ? BankMetrics::now() : 0;
+    // Each account receives exactly one credit, so splitting the accounts
+    // across workers gives the same balances and histories as a
+    // sequential run. Reporting happens afterwards in account order.
+    // The ledger entries are reserved up front in account order.
+    interestStore.resize(savingsAccounts.size());
+    uint64_t firstEntry = ledger.reserve(savingsAccounts.size());
+    int64_t timestamp = CoarseClock::nowNanos();
+    std::atomic<uint64_t> lastLsn{0};
+    runPartitioned(savingsAccounts.size(), interestThreads, 
+                   [this, firstEntry, timestamp, &lastLsn](size_t begin, size_t end) {
+        uint64_t lsn = interestStore.process(savingsAccounts, ledger, begin, end, 
+                                             firstEntry, timestamp);
+        uint64_t current = lastLsn.load();
+        while (lsn > current && !lastLsn.compare_exchange_weak(current, lsn)) {
+        }
+    });
+    ledger.waitDurable(lastLsn.load());
+    if (eventSink) {
+        for (size_t i = 0; i < savingsAccounts.size(); ++i) {
+            eventSink->onInterest(InterestCredit{savingsAccounts[i], interestStore.getInterest(i), 
+                                                 interestStore.getBalanceAfter(i)});
+        }
+    }
+    if (metrics) metrics->recordSince(MetricOperation::Interest, OperationStatus::Ok, start);
+}
+
+bool Bank::writeSnapshot(const std::string& path, uint64_t lsn) const {
+    std::string temporary = path + ".tmp";
+    {
+        std::vector<char> streamBuffer(1 << 20);
+        std::ofstream out;
+        out.rdbuf()->pubsetbuf(streamBuffer.data(), std::streamsize(streamBuffer.size()));
+        out.open(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        
+        std::string header;
+        ByteWriter headerWriter(header);
+        headerWriter.put<uint64_t>(lsn);
+        headerWriter.put<uint64_t>(accounts.size());
+        out.write(snapshotMagic, sizeof(snapshotMagic));
+        out.write(header.data(), std::streamsize(header.size()));
+        
+        std::string productTable;
+        products.forEach([&](const ProductDefinition& product) {
+            encodeProduct(product.getId(), product.getKind(), product.getParameters(), productTable);
+        });
+        std::string productPrefix;
+        ByteWriter productPrefixWriter(productPrefix);
+        productPrefixWriter.put<uint32_t>(static_cast<uint32_t>(products.size()));
+        productPrefixWriter.put<uint64_t>(productTable.size());
+        out.write(productPrefix.data(), std::streamsize(productPrefix.size()));
+        out.write(productTable.data(), std::streamsize(productTable.size()));
+        
+        std::string block;
+        uint32_t blockAccounts = 0;
+        auto flushBlock = [&]() {
+            std::string prefix;
+            ByteWriter prefixWriter(prefix);
+            prefixWriter.put<uint32_t>(blockAccounts);
+            prefixWriter.put<uint64_t>(block.size());
+            out.write(prefix.data(), std::streamsize(prefix.size()));
+            out.write(block.data(), std::streamsize(block.size()));
+            block.clear();
+            blockAccounts = 0;
+        };
+        for (const auto& account : accounts) {
+            ByteWriter writer(block);
+            writer.putString(account->getAccountNumber());
+            writer.putString(account->getHolderName());
+            writer.put<uint16_t>(account->getProduct().getId());
+            writer.put<int64_t>(account->getBalance().getCents());
+            writer.put<uint64_t>(account->getLastEntry());
+            writer.put<uint64_t>(account->getEntryCount());
+            if (++blockAccounts == 16384 || block.size() >= (1 << 20)) {
+                flushBlock();
+            }
+        }
+        if (blockAccounts > 0) flushBlock();
+        
+        ledger.writeTo(out);
+        out.write(snapshotMagic, sizeof(snapshotMagic));
+        out.flush();
+        if (!out) return false;
+    }
+    if (!syncPath(temporary) || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        return false;
+    }
+    return syncPath(dataDirectory);
+}
+
+bool Bank::readSnapshot(const std::string& path, RecoveryStats& stats) {
+    std::vector<char> streamBuffer(1 << 20);
+    std::ifstream in;
+    in.rdbuf()->pubsetbuf(streamBuffer.data(), std::streamsize(streamBuffer.size()));
+    in.open(path, std::ios::binary);
+    if (!in) return true;
+    uint64_t fileSize = remainingBytes(in);
+    auto remaining = [&]() {
+        std::streampos position = in.tellg();
+        return position < 0 ? 0 : fileSize - std::min(fileSize, uint64_t(position));
+    };
+    
+    // Smallest account record: two empty strings, product id, balance,
+    // last entry and entry count
+    constexpr uint64_t minAccountBytes = 2 * sizeof(uint32_t) + sizeof(uint16_t) + 
+                                         3 * sizeof(uint64_t);
+    char magic[sizeof(snapshotMagic)];
+    uint64_t lsn = 0, accountCount = 0;
+    if (!in.read(magic, sizeof(magic)) || 
+        std::memcmp(magic, snapshotMagic, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(&lsn), sizeof(lsn)) ||
+        !in.read(reinterpret_cast<char*>(&accountCount), sizeof(accountCount)) ||
+        accountCount > remaining() / minAccountBytes) {
+        stats.error = "snapshot header is corrupt";
+        return false;
+    }
+    
+    uint32_t productCount = 0;
+    uint64_t tableBytes = 0;
+    in.read(reinterpret_cast<char*>(&productCount), sizeof(productCount));
+    in.read(reinterpret_cast<char*>(&tableBytes), sizeof(tableBytes));
+    if (!in || productCount > ProductCatalog::maxProducts || tableBytes > remaining()) {
+        stats.error = "snapshot product table is corrupt";
+        return false;
+    }
+    std::string table(size_t(tableBytes), '\0');
+    if (!table.empty() && !in.read(&table[0], std::streamsize(table.size()))) {
+        stats.error = "snapshot product table is truncated";
+        return false;
+    }
+    ByteReader tableReader(table.data(), table.size());
+    for (uint32_t i = 0; i < productCount; ++i) {
+        if (!restoreProduct(tableReader)) {
+            stats.error = "snapshot product table is corrupt";
+            return false;
+        }
+    }
+    
+    std::string block;
+    while (accounts.size() < accountCount) {
+        uint32_t blockAccounts = 0;
+        uint64_t blockBytes = 0;
+        in.read(reinterpret_cast<char*>(&blockAccounts), sizeof(blockAccounts));
+        in.read(reinterpret_cast<char*>(&blockBytes), sizeof(blockBytes));
+        if (!in || blockBytes > remaining()) {
+            stats.error = "snapshot account table is truncated";
+            return false;
+        }
+        block.resize(size_t(blockBytes));
+        if (!in.read(&block[0], std::streamsize(block.size()))) {
+            stats.error = "snapshot account table is truncated";
+            return false;
+        }
+        ByteReader reader(block.data(), block.size());
+        for (uint32_t i = 0; i < blockAccounts; ++i) {
+            std::string accNum = reader.getString();
+            std::string holderName = reader.getString();
+            Account* account = restoreAccount(accNum, holderName, reader);
+            Money savedBalance = Money::fromCents(reader.get<int64_t>());
+            uint64_t savedLastEntry = reader.get<uint64_t>();
+            uint64_t savedEntryCount = reader.get<uint64_t>();
+            if (!account || !reader.ok()) {
+                stats.error = "snapshot account table is corrupt";
+                return false;
+            }
+            account->restoreState(savedBalance, savedLastEntry, savedEntryCount);
+        }
+    }
+    
+    if (!ledger.readFrom(in) || !in.read(magic, sizeof(magic)) || 
+        std::memcmp(magic, snapshotMagic, sizeof(magic)) != 0) {
+        stats.error = "snapshot ledger is truncated";
+        return false;
+    }
+    checkpointLsn = lsn;
+    stats.snapshotLoaded = true;
+    stats.snapshotAccounts = accounts.size();
+    stats.snapshotEntries = ledger.size();
+    return true;
+}
+
+bool Bank::replayLog(const std::string& path, RecoveryStats& stats, WriteAheadLog::Tail& tail) {
+    bool ok = true;
+    tail = WriteAheadLog::scan(path, [&](uint64_t lsn, WalRecordType type, ByteReader& payload) {
+        if (!ok || lsn <= checkpointLsn) return;
+        if (type == WalRecordType::LedgerEntries) {
+            uint32_t entries = payload.get<uint32_t>();
+            for (uint32_t e = 0; e < entries; ++e) {
+                uint32_t id = payload.get<uint32_t>();
+                auto entryType = static_cast<TransactionType>(payload.get<uint8_t>());
+                Money amount = Money::fromCents(payload.get<int64_t>());
+                Money balanceAfter = Money::fromCents(payload.get<int64_t>());
+                int64_t timestamp = payload.get<int64_t>();
+                int64_t linkOffset = payload.get<int64_t>();
+                if (!payload.ok() || id >= accounts.size()) {
+                    ok = false;
+                    return;
+                }
+                accounts[id]->replayTransaction(entryType, amount, balanceAfter, 
+                                                timestamp, linkOffset);
+            }
+        } else if (type == WalRecordType::DefineProduct) {
+            if (!restoreProduct(payload)) {
+                ok = false;
+                return;
+            }
+        } else if (type == WalRecordType::CreateAccount) {
+            uint32_t id = payload.get<uint32_t>();
+            std::string accNum = payload.getString();
+            std::string holderName = payload.getString();
+            Account* account = nullptr;
+            if (payload.ok() && id == nextAccountId()) {
+                account = restoreAccount(accNum, holderName, payload);
+            }
+            Money opening = Money::fromCents(payload.get<int64_t>());
+            int64_t timestamp = payload.get<int64_t>();
+            if (!account || !payload.ok()) {
+                ok = false;
+                return;
+            }
+            if (opening > Money()) {
+                account->replayTransaction(TransactionType::InitialDeposit, opening, opening, 
+                                           timestamp, 0);
+            }
+        } else {
+            ok = false;
+            return;
+        }
+        ++stats.replayedRecords;
+    });
+    if (!ok) stats.error = "write-ahead log record does not match the recovered state";
+    return ok;
+}
+
+bool Bank::enableWriteAheadLog(const std::string& path, 
+                               GroupCommitPolicy policy) {
+    auto wal = std::make_unique<WriteAheadLog>();
+    if (!wal->open(path, policy)) return false;
+    journal = std::move(wal);
+    ledger.setJournal(journal.get());
+    journalProducts();
+    return true;
+}
+
+RecoveryStats Bank::openDataDirectory(const std::string& dir, 
+                                      GroupCommitPolicy policy,
+                                      uint64_t checkpointEvery) {
+    auto start = std::chrono::steady_clock::now();
+    RecoveryStats stats;
+    if (!accounts.empty() || journal) {
+        stats.ok = false;
+        stats.error = "bank already has state";
+        return stats;
+    }
+    if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        stats.ok = false;
+        stats.error = "cannot create " + dir;
+        return stats;
+    }
+    dataDirectory = dir;
+    checkpointInterval = checkpointEvery;
+    
+    WriteAheadLog::Tail tail;
+    stats.ok = readSnapshot(snapshotPath(), stats) && replayLog(walPath(), stats, tail);
+    if (stats.ok) {
+        auto wal = std::make_unique<WriteAheadLog>();
+        if (wal->open(walPath(), policy, checkpointLsn, tail)) {
+            journal = std::move(wal);
+            ledger.setJournal(journal.get());
+            journalProducts();
+        } else {
+            stats.ok = false;
+            stats.error = "cannot open " + walPath();
+        }
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+bool Bank::checkpoint() {
+    if (dataDirectory.empty() || !journal) return false;
+    std::lock_guard<std::mutex> lock(accountsMutex);
+    // Another chance for index tables a reader held at the last insert
+    accountIndex.releaseRetiredTables();
+    uint64_t lsn = journal->lastLsn();
+    if (!writeSnapshot(snapshotPath(), lsn)) return false;
+    checkpointLsn = lsn;
+    return journal->reset();
+}
+
+std::vector<InterestCredit> Bank::applyMonthlyInterest() {
+    std::lock_guard<std::mutex> lock(accountsMutex);
+    creditMonthlyInterestLocked();
+    std::vector<InterestCredit> credits;
+    credits.reserve(savingsAccounts.size());
+    for (size_t i = 0; i < savingsAccounts.size(); ++i) {
+        credits.push_back(InterestCredit{savingsAccounts[i], interestStore.getInterest(i), 
+                                         interestStore.getBalanceAfter(i)});
+    }
+    return credits;
+}
+
+bool Bank::exportTransactions(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) return false;
+    ledger.exportCsv(out);
+    return static_cast<bool>(out);
+}
+
+void ActivityLogger::format(const Record& record) {
+    // Consecutive records nearly always share a second, so the calendar
+    // conversion is done once per second
+    int64_t second = record.timestamp / 1000000000;
+    if (second != cachedSecond) {
+        time_t seconds = static_cast<time_t>(second);
+        tm utc;
+        gmtime_r(&seconds, &utc);
+        strftime(cachedTime, sizeof(cachedTime), "%Y-%m-%dT%H:%M:%S", &utc);
+        cachedSecond = second;
+    }
+    int millis = int(record.timestamp / 1000000 % 1000);
+    char line[Money::maxFormattedLength + 8];
+    char* p = line;
+    *p++ = '.';
+    *p++ = char('0' + millis / 100);
+    *p++ = char('0' + millis / 10 % 10);
+    *p++ = char('0' + millis % 10);
+    *p++ = 'Z';
+    *p++ = ' ';
+    pending += cachedTime;
+    pending.append(line, p);
+    pending += kindName(record.kind);
+    pending += ' ';
+    pending += record.account->getAccountNumber();
+    if (record.counterpart) {
+        pending += " -> ";
+        pending += record.counterpart->getAccountNumber();
+    }
+    p = line;
+    *p++ = ' ';
+    p = Money::fromCents(record.amount).format(p);
+    pending.append(line, p);
+    if (record.status == OperationStatus::Ok) {
+        pending += " balance ";
+        pending.append(line, Money::fromCents(record.balance).format(line));
+    } else {
+        pending += " rejected: ";
+        pending += operationStatusName(record.status);
+    }
+    pending += '\n';
+}
+
+void ActivityLogger::writePending() {
+    size_t written = 0;
+    while (written < pending.size()) {
+        ssize_t n = ::write(fd, pending.data() + written, pending.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;   // nowhere to report; keep serving the bank
+        written += size_t(n);
+    }
+    pending.clear();
+}
+
+void ActivityLogger::run() {
+    Record record;
+    for (;;) {
+        bool stop = stopping.load(std::memory_order_acquire);
+        size_t formatted = 0;
+        while (ring.tryPop(record)) {
+            format(record);
+            if (pending.size() >= writeChunk) writePending();
+            ++formatted;
+        }
+        if (stop) break;
+        if (formatted == 0) {
+            // Idle: push out what we have, then poll again shortly
+            if (!pending.empty()) writePending();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    uint64_t lost = dropped.load();
+    if (lost > 0) {
+        pending += std::to_string(lost) + " activity events dropped (log ring full)\n";
+    }
+    writePending();
+}
+
+bool ActivityLogger::open(const std::string& path) {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    pending.reserve(writeChunk + 256);
+    writer = std::thread(&ActivityLogger::run, this);
+    return true;
+}
+
+void ActivityLogger::close() {
+    if (writer.joinable()) {
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
@@ -0,0 +1,2703 @@
+#ifndef BANKING_CORE_H
+#define BANKING_CORE_H
+
+// Banking core: money, accounts, the ledger, the write-ahead log and the
+// Bank itself. Built as the banking_core library shared by the interactive
+// program, the server and the benchmark suite; the per-operation paths are
+// inline here and the rest lives in banking_core.cpp. Nothing in here
+// writes to the console.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <new>
+#include <iomanip>
+#include <ctime>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+#include <exception>
+#include <chrono>
+#include <fstream>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <limits>
+#include <span>
+#include <atomic>
+#include <string_view>
+#include <charconv>
+#include <cinttypes>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+// Rounding applied when a value with more precision than one cent is
+// converted to Money
+enum class RoundingMode {
+    HalfEven,           // banker's rounding, the default for interest
+    HalfAwayFromZero,
+    TowardZero,
+    Floor,
+    Ceiling
+};
+
+// Fixed-point monetary amount stored as a signed count of cents.
+// Arithmetic is exact and checked: any result that does not fit in 64 bits
+// throws std::overflow_error instead of wrapping.
+class Money {
+private:
+    int64_t cents;
+    
+    explicit constexpr Money(int64_t c) : cents(c) {}
+    
+    // Kept out of line so the arithmetic operators stay small enough to
+    // inline into the account rules
+    [[noreturn]] static void throwOverflow(const char* what);
+    
+    static int64_t roundToCents(double value, RoundingMode mode) {
+        double rounded;
+        switch (mode) {
+            case RoundingMode::HalfEven:         rounded = std::nearbyint(value); break;
+            case RoundingMode::HalfAwayFromZero: rounded = std::round(value); break;
+            case RoundingMode::TowardZero:       rounded = std::trunc(value); break;
+            case RoundingMode::Floor:            rounded = std::floor(value); break;
+            case RoundingMode::Ceiling:          rounded = std::ceil(value); break;
+            default:                             rounded = std::nearbyint(value); break;
+        }
+        // 2^63 is exactly representable; anything at or beyond it does not fit
+        if (!(rounded > -9223372036854775808.0 && rounded < 9223372036854775808.0)) {
+            throwOverflow("Money value out of range");
+        }
+        return static_cast<int64_t>(rounded);
+    }
+    
+public:
+    constexpr Money() : cents(0) {}
+    
+    static constexpr Money fromCents(int64_t c) { return Money(c); }
+    
+    static Money fromDouble(double amount, RoundingMode mode = RoundingMode::HalfEven) {
+        return Money(roundToCents(amount * 100.0, mode));
+    }
+    
+    // Parses a decimal amount such as "500", "-12.5" or "0.005" exactly.
+    // Digits beyond the second decimal place are rounded with the given mode.
+    static bool parse(std::string_view text, Money& out, 
+                      RoundingMode mode = RoundingMode::HalfEven) {
+        size_t i = 0;
+        bool negative = false;
+        if (i < text.size() && (text[i] == '-' || text[i] == '+')) {
+            negative = text[i] == '-';
+            ++i;
+        }
+        uint64_t units = 0;
+        bool anyDigits = false;
+        for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+            if (units > (uint64_t(INT64_MAX) - 9) / 10) return false;
+            units = units * 10 + (text[i] - '0');
+            anyDigits = true;
+        }
+        uint64_t fraction = 0;
+        int fractionDigits = 0;
+        bool restNonZero = false;
+        int firstDropped = -1;
+        if (i < text.size() && text[i] == '.') {
+            for (++i; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+                int digit = text[i] - '0';
+                if (fractionDigits < 2) {
+                    fraction = fraction * 10 + digit;
+                    ++fractionDigits;
+                } else if (firstDropped < 0) {
+                    firstDropped = digit;
+                } else if (digit != 0) {
+                    restNonZero = true;
+                }
+                anyDigits = true;
+            }
+        }
+        if (!anyDigits || i != text.size()) return false;
+        for (; fractionDigits < 2; ++fractionDigits) fraction *= 10;
+        
+        if (units > uint64_t(INT64_MAX) / 100) return false;
+        uint64_t magnitude = units * 100 + fraction;
+        
+        // Decide whether the dropped digits round the magnitude up
+        bool dropped = firstDropped > 0 || restNonZero;
+        bool roundUp = false;
+        switch (mode) {
+            case RoundingMode::HalfEven:
+                roundUp = firstDropped > 5 || (firstDropped == 5 && (restNonZero || magnitude % 2 == 1));
+                break;
+            case RoundingMode::HalfAwayFromZero:
+                roundUp = firstDropped >= 5;
+                break;
+            case RoundingMode::TowardZero:
+                break;
+            case RoundingMode::Floor:
+                roundUp = negative && dropped;
+                break;
+            case RoundingMode::Ceiling:
+                roundUp = !negative && dropped;
+                break;
+        }
+        if (roundUp) ++magnitude;
+        if (magnitude > uint64_t(INT64_MAX)) return false;
+        
+        out = Money(negative ? -int64_t(magnitude) : int64_t(magnitude));
+        return true;
+    }
+    
+    int64_t getCents() const { return cents; }
+    double toDouble() const { return cents / 100.0; }
+    
+    // Multiplies by a fractional factor (e.g. a monthly interest rate) and
+    // rounds the result back to whole cents
+    Money applyRate(double factor, RoundingMode mode = RoundingMode::HalfEven) const {
+        return Money(roundToCents(static_cast<double>(cents) * factor, mode));
+    }
+    
+    Money operator+(Money other) const {
+        int64_t result;
+        if (__builtin_add_overflow(cents, other.cents, &result)) {
+            throwOverflow("Money addition overflow");
+        }
+        return Money(result);
+    }
+    
+    Money operator-(Money other) const {
+        int64_t result;
+        if (__builtin_sub_overflow(cents, other.cents, &result)) {
+            throwOverflow("Money subtraction overflow");
+        }
+        return Money(result);
+    }
+    
+    Money operator-() const {
+        if (cents == INT64_MIN) {
+            throwOverflow("Money negation overflow");
+        }
+        return Money(-cents);
+    }
+    
+    Money& operator+=(Money other) { return *this = *this + other; }
+    Money& operator-=(Money other) { return *this = *this - other; }
+    
+    bool operator==(Money other) const { return cents == other.cents; }
+    bool operator!=(Money other) const { return cents != other.cents; }
+    bool operator<(Money other) const { return cents < other.cents; }
+    bool operator<=(Money other) const { return cents <= other.cents; }
+    bool operator>(Money other) const { return cents > other.cents; }
+    bool operator>=(Money other) const { return cents >= other.cents; }
+    
+    // Longest text format can produce: sign, 17 digits, point, 2 digits
+    static constexpr size_t maxFormattedLength = 21;
+    
+    // Writes the amount as "-123.45" without allocating; out must have room
+    // for maxFormattedLength characters. Returns one past the last written.
+    char* format(char* out) const {
+        uint64_t magnitude = cents < 0 ? 0 - uint64_t(cents) : uint64_t(cents);
+        if (cents < 0) *out++ = '-';
+        out = std::to_chars(out, out + 17, magnitude / 100).ptr;
+        *out++ = '.';
+        *out++ = char('0' + magnitude % 100 / 10);
+        *out++ = char('0' + magnitude % 10);
+        return out;
+    }
+    
+    std::string toString() const {
+        char text[maxFormattedLength];
+        return std::string(text, format(text));
+    }
+    
+    friend std::ostream& operator<<(std::ostream& os, Money money) {
+        return os << money.toString();
+    }
+};
+
+// Wall-clock timestamps in nanoseconds since the Unix epoch.
+// On Linux this reads the kernel's cached tick time (CLOCK_REALTIME_COARSE)
+// through the vDSO, which costs a few nanoseconds and has millisecond-level
+// resolution - plenty for transaction records.
+class CoarseClock {
+public:
+    static int64_t nowNanos() {
+#if defined(CLOCK_REALTIME_COARSE)
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+#endif
+    }
+    
+    // Formats like ctime() without the trailing newline,
+    // e.g. "Thu Oct 15 23:08:11 2026"
+    static std::string format(int64_t nanos) {
+        time_t seconds = static_cast<time_t>(nanos / 1000000000);
+        tm local;
+        localtime_r(&seconds, &local);
+        char buffer[32];
+        size_t length = strftime(buffer, sizeof(buffer), "%a %b %e %H:%M:%S %Y", &local);
+        return std::string(buffer, length);
+    }
+};
+
+// Kinds of transaction recorded in an account's history
+enum class TransactionType : uint8_t {
+    InitialDeposit,
+    Deposit,
+    Withdrawal,
+    OverdraftFee,
+    InterestCredit,
+    TransferOut,
+    TransferIn
+};
+
+inline const char* transactionTypeName(TransactionType type) {
+    static const char* const names[] = {
+        "Initial Deposit",
+        "Deposit",
+        "Withdrawal",
+        "Overdraft Fee",
+        "Interest Credit",
+        "Transfer Out",
+        "Transfer In"
+    };
+    return names[static_cast<uint8_t>(type)];
+}
+
+// Transaction class to store transaction history
+class Transaction {
+private:
+    Money amount;
+    Money balanceAfter;
+    int64_t timestamp; // nanoseconds since epoch, formatted only for display
+    TransactionType type;
+    
+public:
+    Transaction(TransactionType t, Money amt, Money balance) 
+        : amount(amt), balanceAfter(balance), timestamp(CoarseClock::nowNanos()), type(t) {}
+    
+    Transaction(TransactionType t, Money amt, Money balance, int64_t nanos) 
+        : amount(amt), balanceAfter(balance), timestamp(nanos), type(t) {}
+    
+    TransactionType getType() const { return type; }
+    const char* getTypeName() const { return transactionTypeName(type); }
+    Money getAmount() const { return amount; }
+    Money getBalanceAfter() const { return balanceAfter; }
+    std::string getTimestamp() const { return CoarseClock::format(timestamp); }
+    int64_t getTimestampNanos() const { return timestamp; }
+    
+    // One history line, as shown by the menu's transaction history
+    void writeTo(std::ostream& out) const {
+        out << "Type: " << transactionTypeName(type) << " | Amount: $" << amount 
+            << " | Balance: $" << balanceAfter 
+            << " | Time: " << CoarseClock::format(timestamp) << '\n';
+    }
+};
+
+// Little-endian-host binary encoding helpers for the on-disk formats
+class ByteWriter {
+private:
+    std::string& out;
+    
+public:
+    explicit ByteWriter(std::string& buffer) : out(buffer) {}
+    
+    template <typename T>
+    void put(T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+    
+    void putString(std::string_view value) {
+        put<uint32_t>(static_cast<uint32_t>(value.size()));
+        out.append(value);
+    }
+};
+
+class ByteReader {
+private:
+    const char* cursor;
+    const char* end;
+    bool valid = true;
+    
+public:
+    ByteReader(const char* data, size_t size) : cursor(data), end(data + size) {}
+    
+    template <typename T>
+    T get() {
+        T value{};
+        if (size_t(end - cursor) < sizeof(T)) {
+            valid = false;
+            return value;
+        }
+        std::memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+    
+    std::string getString() {
+        uint32_t length = get<uint32_t>();
+        if (!valid || size_t(end - cursor) < length) {
+            valid = false;
+            return std::string();
+        }
+        std::string value(cursor, length);
+        cursor += length;
+        return value;
+    }
+    
+    bool ok() const { return valid; }
+};
+
+uint32_t crc32(const char* data, size_t length, uint32_t crc = 0);
+
+// Kinds of record stored in the write-ahead log
+enum class WalRecordType : uint8_t {
+    CreateAccount = 1,  // creation on a product, by product id, with the opening deposit
+    LedgerEntries = 2,  // one or more entries that must be replayed together
+    DefineProduct = 3   // a product's id, kind and current parameters
+};
+
+// When the write-ahead log forces buffered records to disk. By default it
+// syncs as soon as records are waiting and no sync is running, so a batch
+// is whatever arrived during the previous sync: one writer pays a single
+// sync per operation and many writers share each one. A non-zero maxDelay
+// makes it wait up to that long for maxBatch records to gather first,
+// trading latency for fewer syncs where a sync is costly; both are upper
+// bounds on the wait, never a minimum batch.
+struct GroupCommitPolicy {
+    size_t maxBatch = 64;
+    std::chrono::microseconds maxDelay{0};
+};
+
+// Binary write-ahead log with group commit.
+// File layout: the 8-byte magic "BANKWAL1" followed by frames of
+//   u32 payload length | u32 CRC-32 of the rest | u64 LSN | u8 type | payload
+// Producers append records to an in-memory buffer and get back a log
+// sequence number (LSN); a background thread writes and fdatasync()s the
+// buffer in batches according to the GroupCommitPolicy. waitDurable(lsn)
+// blocks until that record is on stable storage, so many concurrent
+// operations share each sync.
+class WriteAheadLog {
+public:
+    // Where the intact part of a log ends, as found by a scan
+    struct Tail {
+        uint64_t validEnd = 0;   // byte offset past the last intact record; 0 if no log
+        uint64_t lastLsn = 0;
+    };
+    
+private:
+    static constexpr char magic[8] = {'B', 'A', 'N', 'K', 'W', 'A', 'L', '1'};
+    static constexpr size_t frameHeaderSize = 4 + 4 + 8 + 1;
+    
+    int fd = -1;
+    GroupCommitPolicy policy;
+    std::mutex mutex;
+    std::condition_variable flushNeeded;
+    std::condition_variable flushed;
+    std::string buffer;
+    size_t pendingRecords = 0;
+    std::chrono::steady_clock::time_point oldestPending;
+    uint64_t appendedLsn = 0;
+    uint64_t durableLsn = 0;
+    bool stopping = false;
+    bool failed = false;
+    std::thread flusher;
+    
+    void flushLoop();
+    
+    bool writeAll(const char* data, size_t length);
+    
+public:
+    using RecordHandler = std::function<void(uint64_t lsn, WalRecordType type, ByteReader& payload)>;
+    
+    WriteAheadLog() = default;
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+    
+    ~WriteAheadLog() { close(); }
+    
+    // Reads every intact record of the log at path in order and returns
+    // where they end. A torn or corrupt frame ends the scan.
+    static Tail scan(const std::string& path, const RecordHandler& handler);
+    
+    // Opens or creates the log. An existing log is scanned so new records
+    // continue its LSN sequence (and never go below minLsn, e.g. the LSN
+    // covered by a snapshot), and any torn tail is truncated away.
+    bool open(const std::string& path, GroupCommitPolicy commitPolicy = GroupCommitPolicy(),
+              uint64_t minLsn = 0);
+    
+    // Like open, for a caller that has just scanned the log itself
+    // (recovery), so the file is not read a second time
+    bool open(const std::string& path, GroupCommitPolicy commitPolicy, uint64_t minLsn, 
+              const Tail& tail);
+    
+    // Flushes everything still buffered and closes the file
+    void close();
+    
+    // Returns the record's LSN
+    uint64_t append(WalRecordType type, const std::string& payload) {
+        std::string frame;
+        frame.reserve(frameHeaderSize + payload.size());
+        ByteWriter writer(frame);
+        writer.put<uint32_t>(static_cast<uint32_t>(payload.size()));
+        writer.put<uint32_t>(0); // checksum, filled in below
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t lsn = ++appendedLsn;
+        writer.put<uint64_t>(lsn);
+        writer.put<uint8_t>(static_cast<uint8_t>(type));
+        frame += payload;
+        uint32_t checksum = crc32(frame.data() + 8, frame.size() - 8);
+        std::memcpy(&frame[4], &checksum, 4);
+        
+        buffer += frame;
+        if (pendingRecords++ == 0) {
+            oldestPending = std::chrono::steady_clock::now();
+            flushNeeded.notify_one();
+        } else if (pendingRecords >= policy.maxBatch) {
+            flushNeeded.notify_one();
+        }
+        return lsn;
+    }
+    
+    // Blocks until the record with the given LSN has been synced to disk
+    void waitDurable(uint64_t lsn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        flushed.wait(lock, [this, lsn]() { return durableLsn >= lsn || failed; });
+        if (durableLsn < lsn) {
+            throw std::runtime_error("write-ahead log write failed");
+        }
+    }
+    
+    uint64_t lastLsn() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return appendedLsn;
+    }
+    
+    // Discards every record once they are all durable, keeping the LSN
+    // sequence. Used after a snapshot has captured their effects; callers
+    // must not append concurrently.
+    bool reset();
+    
+    bool isOpen() const { return fd >= 0; }
+};
+
+// Bank-wide append-only transaction ledger.
+// Entries are stored column by column in fixed-size segments that never move
+// once allocated, so bulk scans and exports read memory sequentially and
+// appends never copy existing history. Each entry also records the previous
+// entry of the same account, which lets an account find its whole history
+// from just the id of its latest entry.
+class Ledger {
+public:
+    static constexpr uint64_t npos = UINT64_MAX;
+    
+private:
+    static constexpr unsigned segmentShift = 16;
+    static constexpr uint64_t segmentSize = uint64_t(1) << segmentShift;
+    static constexpr uint64_t segmentMask = segmentSize - 1;
+    
+    struct Segment {
+        uint32_t accountIds[segmentSize];
+        TransactionType types[segmentSize];
+        int64_t amounts[segmentSize];
+        int64_t balancesAfter[segmentSize];
+        int64_t timestamps[segmentSize];
+        uint64_t previous[segmentSize];
+        uint64_t links[segmentSize];      // counterpart entry of a transfer
+    };
+    
+    // Fixed directory of lazily allocated segments, so segments never move
+    // and reserve() needs no lock
+    static constexpr size_t maxSegments = size_t(1) << 16;
+    
+    std::unique_ptr<std::atomic<Segment*>[]> directory;
+    std::atomic<uint64_t> count{0};
+    WriteAheadLog* journal = nullptr;
+    
+    Segment& segmentOf(uint64_t entry) const { 
+        return *directory[entry >> segmentShift].load(std::memory_order_acquire); 
+    }
+    
+    void ensureSegment(size_t index) {
+        if (directory[index].load(std::memory_order_acquire)) return;
+        Segment* fresh = new Segment;
+        Segment* expected = nullptr;
+        if (!directory[index].compare_exchange_strong(expected, fresh, std::memory_order_acq_rel)) {
+            delete fresh; // another thread installed it first
+        }
+    }
+    
+    void clear() {
+        for (size_t i = 0; i < maxSegments; ++i) {
+            delete directory[i].exchange(nullptr);
+        }
+        count = 0;
+    }
+    
+public:
+    Ledger() : directory(new std::atomic<Segment*>[maxSegments]()) {}
+    Ledger(const Ledger&) = delete;
+    Ledger& operator=(const Ledger&) = delete;
+    ~Ledger() { clear(); }
+    
+    // Reserves n consecutive entries and returns the id of the first one.
+    // Safe to call from any thread. Reserved entries must be filled with
+    // write() before they are read; distinct entries may be written
+    // concurrently. A reservation that does not fit throws and takes its
+    // entries back, so the count never covers entries nobody will write.
+    uint64_t reserve(uint64_t n) {
+        uint64_t first = count.fetch_add(n, std::memory_order_relaxed);
+        if (first + n > (uint64_t(maxSegments) << segmentShift)) {
+            // Every reservation made after this one fails too, so once they
+            // have all given their entries back the count is where the
+            // last successful one left it
+            count.fetch_sub(n, std::memory_order_relaxed);
+            throw std::length_error("ledger is full");
+        }
+        if (n > 0) {
+            for (uint64_t s = first >> segmentShift; s <= (first + n - 1) >> segmentShift; ++s) {
+                ensureSegment(size_t(s));
+            }
+        }
+        return first;
+    }
+    
+    void write(uint64_t entry, uint32_t accountId, TransactionType type, Money amount, 
+               Money balanceAfter, uint64_t previous, int64_t timestamp, uint64_t link = npos) {
+        Segment& segment = segmentOf(entry);
+        uint64_t i = entry & segmentMask;
+        segment.accountIds[i] = accountId;
+        segment.types[i] = type;
+        segment.amounts[i] = amount.getCents();
+        segment.balancesAfter[i] = balanceAfter.getCents();
+        segment.timestamps[i] = timestamp;
+        segment.previous[i] = previous;
+        segment.links[i] = link;
+    }
+    
+    uint64_t append(uint32_t accountId, TransactionType type, Money amount, 
+                    Money balanceAfter, uint64_t previous, 
+                    int64_t timestamp = CoarseClock::nowNanos()) {
+        uint64_t entry = reserve(1);
+        write(entry, accountId, type, amount, balanceAfter, previous, timestamp);
+        return entry;
+    }
+    
+    Transaction at(uint64_t entry) const {
+        const Segment& segment = segmentOf(entry);
+        uint64_t i = entry & segmentMask;
+        return Transaction(segment.types[i], Money::fromCents(segment.amounts[i]),
+                           Money::fromCents(segment.balancesAfter[i]), segment.timestamps[i]);
+    }
+    
+    uint32_t getAccountId(uint64_t entry) const { 
+        return segmentOf(entry).accountIds[entry & segmentMask]; 
+    }
+    
+    uint64_t getPrevious(uint64_t entry) const { 
+        return segmentOf(entry).previous[entry & segmentMask]; 
+    }
+    
+    // The other side of a transfer, or npos
+    uint64_t getLink(uint64_t entry) const { 
+        return segmentOf(entry).links[entry & segmentMask]; 
+    }
+    
+    uint64_t size() const { return count.load(std::memory_order_relaxed); }
+    
+    // Entries are only logged when journaled explicitly, so bulk writers can
+    // fill reserved entries concurrently and log them afterwards in order
+    void setJournal(WriteAheadLog* wal) { journal = wal; }
+    WriteAheadLog* getJournal() const { return journal; }
+    
+    // Logs entries [first, first + n) and returns the LSN of the last record,
+    // or 0 when no journal is attached. Entries are packed into records of
+    // up to maxEntriesPerRecord; a range that fits in one record (such as the
+    // entries of a transfer) is replayed all-or-nothing. Links are stored
+    // relative to the entry so they survive renumbering on replay.
+    uint64_t journalRange(uint64_t first, uint64_t n) {
+        static constexpr uint64_t maxEntriesPerRecord = 4096;
+        if (!journal) return 0;
+        uint64_t lsn = 0;
+        std::string payload;
+        for (uint64_t begin = first; begin < first + n; begin += maxEntriesPerRecord) {
+            uint64_t end = std::min(first + n, begin + maxEntriesPerRecord);
+            payload.clear();
+            ByteWriter writer(payload);
+            writer.put<uint32_t>(static_cast<uint32_t>(end - begin));
+            for (uint64_t entry = begin; entry < end; ++entry) {
+                const Segment& segment = segmentOf(entry);
+                uint64_t i = entry & segmentMask;
+                uint64_t link = segment.links[i];
+                writer.put<uint32_t>(segment.accountIds[i]);
+                writer.put<uint8_t>(static_cast<uint8_t>(segment.types[i]));
+                writer.put<int64_t>(segment.amounts[i]);
+                writer.put<int64_t>(segment.balancesAfter[i]);
+                writer.put<int64_t>(segment.timestamps[i]);
+                writer.put<int64_t>(link == npos ? 0 : int64_t(link - entry));
+            }
+            lsn = journal->append(WalRecordType::LedgerEntries, payload);
+        }
+        return lsn;
+    }
+    
+    void waitDurable(uint64_t lsn) {
+        if (journal && lsn) journal->waitDurable(lsn);
+    }
+    
+    // Snapshot form: the entry count, then each segment's used part column
+    // by column, so saving and loading are a handful of large copies.
+    // Like exportCsv, requires that no entries are being written.
+    void writeTo(std::ostream& out) const;
+    
+    // Replaces the contents with a ledger saved by writeTo
+    bool readFrom(std::istream& in);
+    
+    // Writes every entry as CSV in ledger order
+    void exportCsv(std::ostream& out) const;
+};
+
+// Outcome of a single account operation
+enum class OperationStatus : uint8_t {
+    Ok,
+    AccountNotFound,
+    InvalidAmount,
+    MinimumBalanceBreach,
+    OverdraftLimitExceeded,
+    SameAccount,
+    AccountExists
+};
+
+constexpr size_t operationStatusCount = 7;
+
+inline const char* operationStatusName(OperationStatus status) {
+    static const char* const names[] = {
+        "Ok",
+        "AccountNotFound",
+        "InvalidAmount",
+        "MinimumBalanceBreach",
+        "OverdraftLimitExceeded",
+        "SameAccount",
+        "AccountExists"
+    };
+    return names[static_cast<uint8_t>(status)];
+}
+
+// Status of an account operation plus the balance right after it
+// (zero if the account was not found) and any fee it charged
+struct OperationResult {
+    OperationStatus status;
+    Money balance;
+    Money fee = Money();
+};
+
+// Balance of an account together with its newest ledger entry, as seen
+// at a single point in time
+struct BalanceReading {
+    Money balance;
+    uint64_t lastEntry;   // Ledger::npos if the account has no transactions
+    uint64_t entryCount;
+};
+
+// Bump allocator for objects that live as long as their owner, such as a
+// bank's accounts and their names. Memory comes from slabs that start at
+// 64 KiB and double up to 64 MiB; a slab is never moved or reused, so
+// addresses stay stable, and every slab is freed at once when the arena is
+// destroyed. The arena does not run destructors: owners destroy the objects
+// they created before the arena goes away. Not thread-safe.
+class Arena {
+private:
+    static constexpr size_t firstSlabSize = size_t(64) << 10;
+    static constexpr size_t maxSlabSize = size_t(64) << 20;
+    static constexpr std::align_val_t slabAlignment{64};
+    
+    struct SlabDeleter {
+        void operator()(char* slab) const { ::operator delete(slab, slabAlignment); }
+    };
+    
+    std::vector<std::unique_ptr<char, SlabDeleter>> slabs;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t nextSlabSize = firstSlabSize;
+    size_t reservedBytes = 0;
+    
+    static char* alignUp(char* position, size_t alignment) {
+        auto address = reinterpret_cast<uintptr_t>(position);
+        return reinterpret_cast<char*>((address + alignment - 1) & ~uintptr_t(alignment - 1));
+    }
+    
+    // Starts a new slab big enough for size bytes at the given alignment;
+    // the unused tail of the previous slab is abandoned
+    void addSlab(size_t size, size_t alignment) {
+        size_t slabSize = std::max(nextSlabSize, size + alignment);
+        nextSlabSize = std::min(nextSlabSize * 2, maxSlabSize);
+        slabs.emplace_back(static_cast<char*>(::operator new(slabSize, slabAlignment)));
+        cursor = slabs.back().get();
+        limit = cursor + slabSize;
+        reservedBytes += slabSize;
+    }
+    
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    
+    // Alignment must be a power of two
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        char* start = alignUp(cursor, alignment);
+        if (!cursor || size > size_t(limit - start)) {
+            addSlab(size, alignment);
+            start = alignUp(cursor, alignment);
+        }
+        cursor = start + size;
+        return start;
+    }
+    
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+    
+    // Copies text into the arena; the view stays valid as long as the arena
+    std::string_view copy(std::string_view text) {
+        if (text.empty()) return std::string_view();
+        char* bytes = static_cast<char*>(allocate(text.size(), 1));
+        std::memcpy(bytes, text.data(), text.size());
+        return std::string_view(bytes, text.size());
+    }
+    
+    // Bytes held in slabs, used or not
+    size_t getReservedBytes() const { return reservedBytes; }
+};
+
+// The closed set of account types. Code that needs the concrete type
+// dispatches on the kind with visitAccount instead of through virtual
+// functions, so the per-type rules inline into the calling loop.
+enum class AccountKind : uint8_t {
+    Savings,
+    Current
+};
+
+// Parameters of an account product. Each product reads only the ones its
+// policies need: savings the interest rate and minimum balance, current
+// accounts the overdraft limit and fee.
+struct ProductParameters {
+    double interestRate = 0;
+    Money minimumBalance;
+    Money overdraftLimit;
+    Money overdraftFee;
+};
+
+// One product of a bank, shared by every account opened on it (a
+// flyweight): an account points here instead of carrying its own copy of
+// the parameters. Parameters are atomics, so changing a rate is one update
+// that every account sees from its next operation on. Each parameter
+// changes on its own; an operation running during a change may see some
+// old and some new values.
+class ProductDefinition {
+private:
+    uint16_t id;
+    AccountKind kind;
+    std::atomic<double> interestRate;
+    std::atomic<int64_t> minimumBalance;
+    std::atomic<int64_t> overdraftLimit;
+    std::atomic<int64_t> overdraftFee;
+    
+public:
+    ProductDefinition(uint16_t productId, AccountKind productKind, const ProductParameters& parameters)
+        : id(productId), kind(productKind), interestRate(parameters.interestRate), 
+          minimumBalance(parameters.minimumBalance.getCents()), 
+          overdraftLimit(parameters.overdraftLimit.getCents()), 
+          overdraftFee(parameters.overdraftFee.getCents()) {}
+    
+    uint16_t getId() const { return id; }
+    AccountKind getKind() const { return kind; }
+    
+    double getInterestRate() const { return interestRate.load(std::memory_order_relaxed); }
+    double getMonthlyInterestRate() const { return getInterestRate() / 12; }
+    Money getMinimumBalance() const { 
+        return Money::fromCents(minimumBalance.load(std::memory_order_relaxed)); 
+    }
+    Money getOverdraftLimit() const { 
+        return Money::fromCents(overdraftLimit.load(std::memory_order_relaxed)); 
+    }
+    Money getOverdraftFee() const { 
+        return Money::fromCents(overdraftFee.load(std::memory_order_relaxed)); 
+    }
+    
+    ProductParameters getParameters() const {
+        return ProductParameters{getInterestRate(), getMinimumBalance(), getOverdraftLimit(), 
+                                 getOverdraftFee()};
+    }
+    
+    // Callers serialize changes (the bank holds its accounts mutex)
+    void setParameters(const ProductParameters& parameters) {
+        interestRate.store(parameters.interestRate, std::memory_order_relaxed);
+        minimumBalance.store(parameters.minimumBalance.getCents(), std::memory_order_relaxed);
+        overdraftLimit.store(parameters.overdraftLimit.getCents(), std::memory_order_relaxed);
+        overdraftFee.store(parameters.overdraftFee.getCents(), std::memory_order_relaxed);
+    }
+};
+
+// A bank's products, indexed by id. Ids are small so that account records
+// on disk name their product in two bytes. Definitions never move once
+// added. Not thread-safe: the bank changes the catalog under its accounts
+// mutex, and accounts read their own definition, never the catalog.
+class ProductCatalog {
+private:
+    std::vector<std::unique_ptr<ProductDefinition>> products;
+    
+public:
+    static constexpr size_t maxProducts = size_t(UINT16_MAX) + 1;
+    
+    ProductDefinition* find(uint16_t id) const {
+        return id < products.size() ? products[id].get() : nullptr;
+    }
+    
+    // Null once maxProducts exist
+    ProductDefinition* add(AccountKind kind, const ProductParameters& parameters) {
+        if (products.size() >= maxProducts) return nullptr;
+        products.push_back(std::make_unique<ProductDefinition>(
+            static_cast<uint16_t>(products.size()), kind, parameters));
+        return products.back().get();
+    }
+    
+    // Recovery: sets the parameters of product id, adding it if id is the
+    // next free one. Null if id is out of sequence or of another kind.
+    ProductDefinition* define(uint16_t id, AccountKind kind, const ProductParameters& parameters) {
+        if (id == products.size()) return add(kind, parameters);
+        ProductDefinition* product = find(id);
+        if (!product || product->getKind() != kind) return nullptr;
+        product->setParameters(parameters);
+        return product;
+    }
+    
+    size_t size() const { return products.size(); }
+    
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const auto& product : products) {
+            fn(*product);
+        }
+    }
+};
+
+// Base class of SavingsAccount and CurrentAccount, the only account types.
+// Every public operation is safe to call from any thread: it takes the
+// account's own mutex, so operations on different accounts never contend.
+// Members documented as "caller holds getMutex()" are building blocks for
+// Bank operations that lock several accounts at once.
+// Balance reads do not lock at all: writers publish the balance and newest
+// entry under a sequence counter (a seqlock) and readers retry if a write
+// overlapped their read.
+// The account number and holder name are views: whoever creates the account
+// keeps the characters alive at least as long as the account (a bank keeps
+// them in its arena).
+class Account {
+protected:
+    std::string_view accountNumber;
+    std::string_view holderName;
+    Money balance;
+    Ledger* ledger;
+    const ProductDefinition* product;   // shared product parameters
+    uint32_t accountId;                 // position of this account in its bank
+    AccountKind kind;
+    uint64_t lastEntry = Ledger::npos;  // newest ledger entry of this account
+    uint64_t entryCount = 0;
+    std::atomic<uint64_t> pendingLsn{0};  // journal record of the newest entry
+    mutable std::mutex mutex;
+    
+    // Seqlock-published copy of balance, lastEntry and entryCount. The
+    // version is odd while a write is in progress. Kept on its own cache
+    // line so readers spinning on it do not slow down the mutex.
+    struct alignas(64) Published {
+        std::atomic<uint64_t> version{0};
+        std::atomic<int64_t> balance{0};
+        std::atomic<uint64_t> lastEntry{Ledger::npos};
+        std::atomic<uint64_t> entryCount{0};
+    };
+    Published published;
+    
+    // Makes the current balance and chain head visible to lock-free
+    // readers. Caller holds getMutex(), so there is a single writer.
+    void publish() {
+        uint64_t version = published.version.load(std::memory_order_relaxed);
+        published.version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        published.balance.store(balance.getCents(), std::memory_order_relaxed);
+        published.lastEntry.store(lastEntry, std::memory_order_relaxed);
+        published.entryCount.store(entryCount, std::memory_order_relaxed);
+        published.version.store(version + 2, std::memory_order_release);
+    }
+    
+    // Records a ledger entry without journaling it. Caller holds getMutex().
+    void appendTransaction(TransactionType type, Money amount) {
+        lastEntry = ledger->append(accountId, type, amount, balance, lastEntry);
+        ++entryCount;
+        publish();
+    }
+    
+    // Caller holds getMutex()
+    void addTransaction(TransactionType type, Money amount) {
+        appendTransaction(type, amount);
+        setPendingLsn(ledger->journalRange(lastEntry, 1));
+    }
+    
+    // Only the concrete account types construct accounts. The product
+    // must be of their kind and outlive the account. The opening deposit is
+    // not journaled here: the bank logs it inside the creation record.
+    Account(AccountKind accountKind, Ledger& ledger, uint32_t id, std::string_view accNum, 
+            std::string_view name, const ProductDefinition& accountProduct, Money initialBalance)
+        : accountNumber(accNum), holderName(name), balance(initialBalance), 
+          ledger(&ledger), product(&accountProduct), accountId(id), kind(accountKind) {
+        publish();
+        if (initialBalance > Money()) {
+            appendTransaction(TransactionType::InitialDeposit, initialBalance);
+        }
+    }
+    
+    ~Account() = default;
+    
+public:
+    Account(const Account&) = delete;
+    Account& operator=(const Account&) = delete;
+    
+    AccountKind getKind() const { return kind; }
+    const ProductDefinition& getProduct() const { return *product; }
+    
+    // Checks whether amount may leave the account under its product rules,
+    // without changing anything; sets fee to any charge that would apply.
+    // Caller holds getMutex(). Dispatches on the kind (defined below the
+    // concrete types).
+    OperationStatus checkWithdrawal(Money amount, Money& fee) const;
+    std::string getAccountType() const;
+    
+    // Common methods for all account types
+    
+    // Lock-free; never blocks writers. The balance and entry returned always
+    // belong together: balance is the balance recorded in lastEntry.
+    BalanceReading readBalance() const {
+        for (;;) {
+            uint64_t version = published.version.load(std::memory_order_acquire);
+            if (version & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            BalanceReading reading{
+                Money::fromCents(published.balance.load(std::memory_order_relaxed)),
+                published.lastEntry.load(std::memory_order_relaxed),
+                published.entryCount.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (published.version.load(std::memory_order_relaxed) == version) {
+                return reading;
+            }
+        }
+    }
+    
+    Money getBalance() const { return readBalance().balance; }
+    
+    // Caller holds getMutex()
+    Money getBalanceLocked() const { return balance; }
+    
+    // Immutable after construction, so no locking needed
+    std::string_view getAccountNumber() const { return accountNumber; }
+    std::string_view getHolderName() const { return holderName; }
+    uint32_t getAccountId() const { return accountId; }
+    
+    // Only meaningful while the bank is quiescent (snapshots)
+    uint64_t getLastEntry() const { return lastEntry; }
+    uint64_t getEntryCount() const { return entryCount; }
+    
+    std::mutex& getMutex() const { return mutex; }
+    
+    // Recovery only: re-applies a logged ledger entry without journaling it
+    void replayTransaction(TransactionType type, Money amount, Money balanceAfter, 
+                           int64_t timestamp, int64_t linkOffset) {
+        balance = balanceAfter;
+        uint64_t entry = ledger->reserve(1);
+        ledger->write(entry, accountId, type, amount, balance, lastEntry, timestamp,
+                      linkOffset ? uint64_t(int64_t(entry) + linkOffset) : Ledger::npos);
+        lastEntry = entry;
+        ++entryCount;
+        publish();
+    }
+    
+    // Recovery only: restores the state saved in a snapshot
+    void restoreState(Money savedBalance, uint64_t savedLastEntry, uint64_t savedEntryCount) {
+        balance = savedBalance;
+        lastEntry = savedLastEntry;
+        entryCount = savedEntryCount;
+        publish();
+    }
+    
+    // Oldest first, reconstructed by walking this account's ledger chain
+    std::vector<Transaction> getTransactionHistory() const {
+        return getRecentTransactions(SIZE_MAX);
+    }
+    
+    // The newest limit transactions, oldest first
+    std::vector<Transaction> getRecentTransactions(size_t limit) const {
+        // Entries are immutable once published, so the chain behind a
+        // consistent head can be walked without locking
+        BalanceReading reading = readBalance();
+        size_t count = static_cast<size_t>(std::min<uint64_t>(limit, reading.entryCount));
+        std::vector<Transaction> history;
+        history.reserve(count);
+        uint64_t entry = reading.lastEntry;
+        for (size_t i = 0; i < count; ++i) {
+            history.push_back(ledger->at(entry));
+            entry = ledger->getPrevious(entry);
+        }
+        std::reverse(history.begin(), history.end());
+        return history;
+    }
+    
+    // Deposits and withdrawals return once the transaction is durable in
+    // the write-ahead log. They never print; see OperationResult.
+    OperationResult deposit(Money amount) {
+        OperationResult result = applyDeposit(amount);
+        if (result.status == OperationStatus::Ok) {
+            commitTransactions();
+        }
+        return result;
+    }
+    
+    OperationResult withdraw(Money amount) {
+        OperationResult result = applyWithdrawal(amount);
+        if (result.status == OperationStatus::Ok) {
+            commitTransactions();
+        }
+        return result;
+    }
+    
+    // Like withdraw, but without waiting for durability
+    OperationResult applyWithdrawal(Money amount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Money fee;
+        OperationStatus status = checkWithdrawal(amount, fee);
+        if (status != OperationStatus::Ok) {
+            return OperationResult{status, balance};
+        }
+        // Overflow throws here rather than after the entries are reserved
+        static_cast<void>(balance - amount - fee);
+        // The withdrawal and its fee go into one log record, so replay
+        // never applies one without the other
+        uint64_t entries = fee > Money() ? 2 : 1;
+        uint64_t entry = ledger->reserve(entries);
+        int64_t timestamp = CoarseClock::nowNanos();
+        balance -= amount;
+        addTransactionAt(entry, TransactionType::Withdrawal, amount, timestamp);
+        if (fee > Money()) {
+            balance -= fee;
+            addTransactionAt(entry + 1, TransactionType::OverdraftFee, fee, timestamp);
+        }
+        setPendingLsn(ledger->journalRange(entry, entries));
+        return OperationResult{OperationStatus::Ok, balance, fee};
+    }
+    
+    // Like deposit, but without waiting for durability
+    OperationResult applyDeposit(Money amount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (amount <= Money()) {
+            return OperationResult{OperationStatus::InvalidAmount, balance};
+        }
+        balance += amount;
+        addTransaction(TransactionType::Deposit, amount);
+        return OperationResult{OperationStatus::Ok, balance};
+    }
+    
+    // Moves amount out of this account into reserved ledger entries:
+    // outEntry for the transfer, outEntry + 1 for any fee. inEntry is the
+    // receiving side's entry. Returns the number of entries written.
+    // Caller holds getMutex().
+    uint64_t applyTransferOut(Money amount, Money fee, uint64_t outEntry, 
+                              uint64_t inEntry, int64_t timestamp) {
+        balance -= amount;
+        addTransactionAt(outEntry, TransactionType::TransferOut, amount, timestamp, inEntry);
+        if (fee > Money()) {
+            balance -= fee;
+            addTransactionAt(outEntry + 1, TransactionType::OverdraftFee, fee, timestamp);
+            return 2;
+        }
+        return 1;
+    }
+    
+    // Caller holds getMutex()
+    void applyTransferIn(Money amount, uint64_t inEntry, uint64_t outEntry, int64_t timestamp) {
+        balance += amount;
+        addTransactionAt(inEntry, TransactionType::TransferIn, amount, timestamp, outEntry);
+    }
+    
+    // Called before an operation is reported as done, without holding the
+    // account lock: returns once every transaction recorded so far is
+    // durable in the write-ahead log
+    void commitTransactions() {
+        ledger->waitDurable(pendingLsn.load(std::memory_order_acquire));
+    }
+    
+    // Fills a ledger entry reserved in advance by the caller (bulk paths and
+    // transfers). The caller journals the reserved range and holds getMutex().
+    void addTransactionAt(uint64_t entry, TransactionType type, Money amount, int64_t timestamp,
+                          uint64_t link = Ledger::npos) {
+        ledger->write(entry, accountId, type, amount, balance, lastEntry, timestamp, link);
+        lastEntry = entry;
+        ++entryCount;
+        publish();
+    }
+    
+    void setPendingLsn(uint64_t lsn) {
+        // LSNs only grow; keep the newest one
+        uint64_t current = pendingLsn.load(std::memory_order_relaxed);
+        while (lsn > current && 
+               !pendingLsn.compare_exchange_weak(current, lsn, std::memory_order_release)) {
+        }
+    }
+};
+
+// Account products are composed at compile time from three policies:
+//   withdrawal limit - how low a withdrawal may take the balance, and the
+//                      status reported when it would go lower
+//   fee              - what a permitted withdrawal costs on top
+//   interest         - whether and at what rate the account earns interest
+// A product struct names its kind, display name, policies and default
+// parameters, and ProductAccount<Product> is the account type. Every
+// combination is its own final class, so the rules inline wherever the type
+// is known. The policies hold no state: they read the parameters from the
+// account's ProductDefinition. Adding a product means a product struct, an
+// AccountKind, and a case in visitAccount and Bank::createAccountOn, which
+// -Wswitch points out; the deposit and withdrawal code is shared.
+
+// Withdrawal limit: the balance may not fall below a minimum
+class MinimumBalanceLimit {
+public:
+    static constexpr OperationStatus breachStatus = OperationStatus::MinimumBalanceBreach;
+    
+    static bool allows(const ProductDefinition& product, Money balanceAfter) {
+        return !(balanceAfter < product.getMinimumBalance());
+    }
+};
+
+// Withdrawal limit: the balance may go negative down to the overdraft limit
+class OverdraftLimit {
+public:
+    static constexpr OperationStatus breachStatus = OperationStatus::OverdraftLimitExceeded;
+    
+    static bool allows(const ProductDefinition& product, Money balanceAfter) {
+        return !(balanceAfter < -product.getOverdraftLimit());
+    }
+};
+
+// Fee: withdrawals are free
+class NoWithdrawalFee {
+public:
+    static Money feeFor(const ProductDefinition& /*product*/, Money /*balanceAfter*/) { 
+        return Money(); 
+    }
+};
+
+// Fee: a flat fee on every withdrawal that leaves the balance negative
+class OverdraftFee {
+public:
+    static Money feeFor(const ProductDefinition& product, Money balanceAfter) {
+        return balanceAfter < Money() ? product.getOverdraftFee() : Money();
+    }
+};
+
+// Interest: none
+class NoInterest {
+public:
+    static constexpr bool paysInterest = false;
+};
+
+// Interest: the product's annual rate, credited monthly
+class MonthlyInterest {
+public:
+    static constexpr bool paysInterest = true;
+    
+    static double monthlyRate(const ProductDefinition& product) {
+        return product.getMonthlyInterestRate();
+    }
+};
+
+struct SavingsProduct {
+    static constexpr AccountKind kind = AccountKind::Savings;
+    static constexpr const char* name = "Savings";
+    static constexpr double defaultInterestRate = 0.04;
+    static constexpr Money defaultMinimumBalance = Money::fromCents(10000);
+    static constexpr ProductParameters defaultParameters{defaultInterestRate, defaultMinimumBalance, 
+                                                         Money(), Money()};
+    
+    using WithdrawalLimit = MinimumBalanceLimit;
+    using Fee = NoWithdrawalFee;
+    using Interest = MonthlyInterest;
+};
+
+struct CurrentProduct {
+    static constexpr AccountKind kind = AccountKind::Current;
+    static constexpr const char* name = "Current";
+    static constexpr Money defaultOverdraftLimit = Money::fromCents(100000);
+    static constexpr Money defaultOverdraftFee = Money::fromCents(2500);
+    static constexpr ProductParameters defaultParameters{0, Money(), defaultOverdraftLimit, 
+                                                         defaultOverdraftFee};
+    
+    using WithdrawalLimit = OverdraftLimit;
+    using Fee = OverdraftFee;
+    using Interest = NoInterest;
+};
+
+// An account of one product. The product struct is a base, so its
+// defaults are members of the account type.
+template <typename Product>
+class ProductAccount final : public Account, public Product {
+public:
+    using WithdrawalLimit = typename Product::WithdrawalLimit;
+    using Fee = typename Product::Fee;
+    using Interest = typename Product::Interest;
+    static constexpr AccountKind accountKind = Product::kind;
+    
+    ProductAccount(Ledger& ledger, uint32_t id, std::string_view accNum, std::string_view name, 
+                   const ProductDefinition& accountProduct, Money initialBalance = Money())
+        : Account(accountKind, ledger, id, accNum, name, accountProduct, initialBalance) {}
+    
+    OperationStatus checkWithdrawal(Money amount, Money& fee) const {
+        fee = Money();
+        if (amount <= Money()) {
+            return OperationStatus::InvalidAmount;
+        }
+        Money balanceAfter = balance - amount;
+        if (!WithdrawalLimit::allows(*product, balanceAfter)) {
+            return WithdrawalLimit::breachStatus;
+        }
+        fee = Fee::feeFor(*product, balanceAfter);
+        return OperationStatus::Ok;
+    }
+    
+    // Credits one month of interest to this account alone; returns the
+    // interest once it is durable
+    Money applyInterest() requires Interest::paysInterest {
+        Money interest;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            interest = balance.applyRate(Interest::monthlyRate(*product));
+            balance += interest;
+            addTransaction(TransactionType::InterestCredit, interest);
+        }
+        commitTransactions();
+        return interest;
+    }
+    
+    // Credits an already computed interest amount into a ledger entry
+    // reserved by the caller (see SavingsInterestStore).
+    // Caller holds getMutex().
+    void creditInterestAt(Money interest, uint64_t entry, int64_t timestamp) 
+        requires Interest::paysInterest {
+        balance += interest;
+        addTransactionAt(entry, TransactionType::InterestCredit, interest, timestamp);
+    }
+    
+    std::string getAccountType() const {
+        return Product::name;
+    }
+};
+
+using SavingsAccount = ProductAccount<SavingsProduct>;
+using CurrentAccount = ProductAccount<CurrentProduct>;
+
+// Calls fn with the account as its concrete type. The set of types is
+// closed, so this is a switch on the kind and both calls can be inlined,
+// where a virtual call could not.
+template <typename Fn>
+decltype(auto) visitAccount(Account& account, Fn&& fn) {
+    // No default: -Wswitch flags a kind without a case
+    switch (account.getKind()) {
+        case AccountKind::Savings: return fn(static_cast<SavingsAccount&>(account));
+        case AccountKind::Current: return fn(static_cast<CurrentAccount&>(account));
+    }
+    std::abort();
+}
+
+template <typename Fn>
+decltype(auto) visitAccount(const Account& account, Fn&& fn) {
+    switch (account.getKind()) {
+        case AccountKind::Savings: return fn(static_cast<const SavingsAccount&>(account));
+        case AccountKind::Current: return fn(static_cast<const CurrentAccount&>(account));
+    }
+    std::abort();
+}
+
+// The account as T, or null if it is of another type
+template <typename T>
+T* accountCast(Account* account) {
+    return account && account->getKind() == T::accountKind ? static_cast<T*>(account) : nullptr;
+}
+
+template <typename T>
+const T* accountCast(const Account* account) {
+    return account && account->getKind() == T::accountKind ? static_cast<const T*>(account) : nullptr;
+}
+
+inline OperationStatus Account::checkWithdrawal(Money amount, Money& fee) const {
+    return visitAccount(*this, [&](const auto& account) { return account.checkWithdrawal(amount, fee); });
+}
+
+inline std::string Account::getAccountType() const {
+    return visitAccount(*this, [](const auto& account) { return account.getAccountType(); });
+}
+
+// A pair of fences for a side that runs constantly and a side that runs
+// rarely. On Linux the rare side makes every running thread of the process
+// execute a full barrier (membarrier), so the constant side only has to
+// keep the compiler from reordering; elsewhere both sides issue a real fence.
+class AsymmetricFence {
+private:
+    static bool registerExpedited();
+    static inline const bool expedited = registerExpedited();
+    
+public:
+    static void light() {
+        if (expedited) {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } else {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+    
+    static void heavy();
+};
+
+// Slots that each have a single writer thread. A thread leases a slot of
+// the pool it last used for as long as it runs; the slot goes back to the
+// pool when the thread exits or moves on to another pool, and is reused,
+// contents included, by the next thread. The pool is shared with the
+// leases, so it outlives its owner while a thread that used it still runs.
+template <typename Slot>
+class ThreadSlotPool {
+private:
+    struct Pool {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::vector<Slot*> unused;
+    };
+    
+    // One thread's claim on a slot of the pool it last used
+    struct Lease {
+        std::shared_ptr<Pool> pool;
+        uint64_t owner = 0;
+        Slot* slot = nullptr;
+        
+        // The pool may go with this last reference, so it is only dropped
+        // once its mutex is unlocked
+        void release() {
+            if (!pool) return;
+            std::shared_ptr<Pool> released = std::move(pool);
+            {
+                std::lock_guard<std::mutex> lock(released->mutex);
+                released->unused.push_back(slot);
+            }
+            slot = nullptr;
+            owner = 0;
+        }
+        
+        ~Lease() { release(); }
+    };
+    
+    std::shared_ptr<Pool> pool = std::make_shared<Pool>();
+    uint64_t instanceId;
+    
+    static uint64_t nextInstanceId() {
+        static std::atomic<uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+public:
+    ThreadSlotPool() : instanceId(nextInstanceId()) {}
+    
+    ThreadSlotPool(const ThreadSlotPool&) = delete;
+    ThreadSlotPool& operator=(const ThreadSlotPool&) = delete;
+    
+    // The calling thread's slot
+    Slot& local() {
+        thread_local Lease lease;
+        if (lease.owner != instanceId) {
+            lease.release();
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            if (pool->unused.empty()) {
+                pool->slots.push_back(std::make_unique<Slot>());
+                lease.slot = pool->slots.back().get();
+            } else {
+                lease.slot = pool->unused.back();
+                pool->unused.pop_back();
+            }
+            lease.pool = pool;
+            lease.owner = instanceId;
+        }
+        return *lease.slot;
+    }
+    
+    // Visits every slot, leased or not; no thread can lease one meanwhile
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        for (const auto& slot : pool->slots) {
+            fn(*slot);
+        }
+    }
+};
+
+// Open-addressing hash index from account number to account.
+// Slots are a flat array of (hash, pointer) pairs probed linearly, so a lookup
+// usually touches a single cache line and only dereferences the account to
+// confirm a full hash match.
+// find() is lock-free and may run concurrently with insert(); inserts must be
+// serialized by the caller. Growing publishes a new table and retires the
+// old one. Each reader announces the table it probes in a slot of its own
+// (a hazard pointer), and insert() frees retired tables once no slot names
+// one of them. The reader's fence is the light side of an AsymmetricFence,
+// so a lookup costs two plain stores more than an unprotected probe.
+class AccountIndex {
+private:
+    struct Slot {
+        std::atomic<uint64_t> hash{0};
+        std::atomic<Account*> account{nullptr};
+    };
+    
+    struct Table {
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+        
+        explicit Table(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+        
+        // Publishes the pointer last so readers never see a half-written slot
+        void place(uint64_t h, Account* account) {
+            size_t pos = h & mask;
+            while (slots[pos].account.load(std::memory_order_relaxed)) {
+                pos = (pos + 1) & mask;
+            }
+            slots[pos].hash.store(h, std::memory_order_relaxed);
+            slots[pos].account.store(account, std::memory_order_release);
+        }
+    };
+    
+    struct alignas(64) ReaderSlot {
+        std::atomic<const Table*> table{nullptr};
+    };
+    
+    std::atomic<Table*> current{nullptr};
+    std::vector<std::unique_ptr<Table>> tables;  // current table last
+    mutable ThreadSlotPool<ReaderSlot> readers;
+    size_t count = 0;
+    
+    static uint64_t hashKey(std::string_view key) {
+        // FNV-1a followed by a final avalanche so linear probing stays short
+        uint64_t h = 14695981039346656037ULL;
+        for (unsigned char c : key) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+    
+    void grow() {
+        Table* old = current.load(std::memory_order_relaxed);
+        auto table = std::make_unique<Table>(old ? (old->mask + 1) * 2 : 16);
+        if (old) {
+            for (size_t i = 0; i <= old->mask; ++i) {
+                if (Account* account = old->slots[i].account.load(std::memory_order_relaxed)) {
+                    table->place(old->slots[i].hash.load(std::memory_order_relaxed), account);
+                }
+            }
+        }
+        current.store(table.get(), std::memory_order_release);
+        tables.push_back(std::move(table));
+    }
+    
+    static Account* probe(const Table& table, std::string_view accNum) {
+        uint64_t h = hashKey(accNum);
+        for (size_t pos = h & table.mask; ; pos = (pos + 1) & table.mask) {
+            Account* account = table.slots[pos].account.load(std::memory_order_acquire);
+            if (!account) return nullptr;
+            if (table.slots[pos].hash.load(std::memory_order_relaxed) == h && 
+                account->getAccountNumber() == accNum) {
+                return account;
+            }
+        }
+    }
+    
+public:
+    // Returns false if the account number is already indexed
+    bool insert(Account* account) {
+        if (find(account->getAccountNumber())) {
+            return false;
+        }
+        // Keep the load factor at or below one half
+        Table* table = current.load(std::memory_order_relaxed);
+        if (!table || (count + 1) * 2 > table->mask + 1) {
+            grow();
+            table = current.load(std::memory_order_relaxed);
+        }
+        table->place(hashKey(account->getAccountNumber()), account);
+        ++count;
+        releaseRetiredTables();
+        return true;
+    }
+    
+    Account* find(std::string_view accNum) const {
+        ReaderSlot& slot = readers.local();
+        const Table* table = current.load(std::memory_order_acquire);
+        // Announce the table, then check it was not retired in between
+        for (;;) {
+            slot.table.store(table, std::memory_order_relaxed);
+            AsymmetricFence::light();
+            const Table* latest = current.load(std::memory_order_acquire);
+            if (latest == table) break;
+            table = latest;
+        }
+        Account* account = table ? probe(*table, accNum) : nullptr;
+        slot.table.store(nullptr, std::memory_order_release);
+        return account;
+    }
+    
+    // Frees superseded tables unless a reader still holds one; they are
+    // tried again on the next call. Serialized with insert() by the caller.
+    void releaseRetiredTables() {
+        if (tables.size() < 2) return;
+        // Pairs with the readers' fence: a reader that can still load a
+        // retired table has announced it by now
+        AsymmetricFence::heavy();
+        bool inUse = false;
+        readers.forEach([&](const ReaderSlot& slot) {
+            const Table* held = slot.table.load(std::memory_order_acquire);
+            if (held && held != tables.back().get()) inUse = true;
+        });
+        if (!inUse) {
+            tables.erase(tables.begin(), tables.end() - 1);
+        }
+    }
+    
+    // Superseded tables not freed yet. Serialized with insert() by the caller.
+    size_t retiredTables() const { return tables.empty() ? 0 : tables.size() - 1; }
+    
+    size_t size() const { return count; }
+};
+
+inline void computeMonthlyInterestScalar(const int64_t* balances, const double* monthlyRates,
+                                         int64_t* interest, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        interest[i] = Money::fromCents(balances[i]).applyRate(monthlyRates[i]).getCents();
+    }
+}
+
+// Computes interest[i] = round_half_even(balances[i] * monthlyRates[i]) in
+// cents. Produces exactly the same values as Money::applyRate with
+// RoundingMode::HalfEven, so the batch and per-account paths agree.
+inline void computeMonthlyInterest(const int64_t* balances, const double* monthlyRates,
+                                   int64_t* interest, size_t count) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    // int64 <-> double conversion via the 2^52 + 2^51 bias trick, exact for
+    // magnitudes below 2^51 cents. Blocks with larger values take the scalar
+    // path, which also reports overflow.
+    const __m256d bias = _mm256_set1_pd(6755399441055744.0);
+    const __m256i biasBits = _mm256_castpd_si256(bias);
+    const __m256i upper = _mm256_set1_epi64x(int64_t(1) << 51);
+    const __m256i lower = _mm256_set1_epi64x(-(int64_t(1) << 51));
+    const __m256d limit = _mm256_set1_pd(2251799813685248.0);
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    for (; i + 4 <= count; i += 4) {
+        __m256i cents = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(balances + i));
+        __m256i inRange = _mm256_and_si256(_mm256_cmpgt_epi64(upper, cents),
+                                           _mm256_cmpgt_epi64(cents, lower));
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(inRange)) != 0xF) {
+            computeMonthlyInterestScalar(balances + i, monthlyRates + i, interest + i, 4);
+            continue;
+        }
+        
+        __m256d value = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_add_epi64(cents, biasBits)), bias);
+        __m256d product = _mm256_mul_pd(value, _mm256_loadu_pd(monthlyRates + i));
+        __m256d rounded = _mm256_round_pd(product, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d fits = _mm256_cmp_pd(_mm256_andnot_pd(signMask, rounded), limit, _CMP_LT_OQ);
+        if (_mm256_movemask_pd(fits) != 0xF) {
+            computeMonthlyInterestScalar(balances + i, monthlyRates + i, interest + i, 4);
+            continue;
+        }
+        
+        __m256i result = _mm256_sub_epi64(
+            _mm256_castpd_si256(_mm256_add_pd(rounded, bias)), biasBits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(interest + i), result);
+    }
+#endif
+    computeMonthlyInterestScalar(balances + i, monthlyRates + i, interest + i, count - i);
+}
+
+// Column-oriented scratch store used by the monthly interest run. Balances
+// and rates are gathered into contiguous arrays so the interest kernel
+// streams through memory instead of chasing account pointers.
+class SavingsInterestStore {
+private:
+    static constexpr size_t lockChunk = 256;
+    
+    std::vector<int64_t> balances;
+    std::vector<double> monthlyRates;
+    std::vector<int64_t> interest;
+    
+public:
+    void resize(size_t count) {
+        balances.resize(count);
+        monthlyRates.resize(count);
+        interest.resize(count);
+    }
+    
+    // Gathers, computes and credits interest for accounts [begin, end).
+    // Account i records its credit in ledger entry firstEntry + i, which the
+    // caller has reserved. Disjoint ranges touch disjoint accounts, columns
+    // and ledger entries, so they may be processed concurrently.
+    // Accounts are locked a chunk at a time in ascending id order, the same
+    // order transfers use, and each chunk is journaled before its locks are
+    // released so the log orders it correctly against other operations on
+    // those accounts. Returns the newest log record written.
+    // Every credit of a chunk is computed and checked for overflow before
+    // any is applied, so a Money overflow throws with the chunk untouched
+    // and its locks released.
+    uint64_t process(const std::vector<SavingsAccount*>& savingsAccounts, Ledger& ledger, 
+                     size_t begin, size_t end, uint64_t firstEntry, int64_t timestamp) {
+        uint64_t lsn = 0;
+        for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += lockChunk) {
+            size_t chunkEnd = std::min(end, chunkBegin + lockChunk);
+            std::array<std::unique_lock<std::mutex>, lockChunk> locks;
+            for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+                locks[i - chunkBegin] = std::unique_lock<std::mutex>(savingsAccounts[i]->getMutex());
+                balances[i] = savingsAccounts[i]->getBalanceLocked().getCents();
+                monthlyRates[i] = savingsAccounts[i]->getProduct().getMonthlyInterestRate();
+            }
+            computeMonthlyInterest(balances.data() + chunkBegin, monthlyRates.data() + chunkBegin,
+                                   interest.data() + chunkBegin, chunkEnd - chunkBegin);
+            for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+                balances[i] = (Money::fromCents(balances[i]) + Money::fromCents(interest[i])).getCents();
+            }
+            for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+                savingsAccounts[i]->creditInterestAt(Money::fromCents(interest[i]), 
+                                                     firstEntry + i, timestamp);
+            }
+            lsn = ledger.journalRange(firstEntry + chunkBegin, chunkEnd - chunkBegin);
+            for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+                savingsAccounts[i]->setPendingLsn(lsn);
+            }
+        }
+        return lsn;
+    }
+    
+    size_t size() const { return interest.size(); }
+    Money getInterest(size_t i) const { return Money::fromCents(interest[i]); }
+    // Balance right after the credit
+    Money getBalanceAfter(size_t i) const { return Money::fromCents(balances[i]); }
+};
+
+// Splits [0, count) into contiguous chunks, one per worker, and runs
+// fn(begin, end) on each. The calling thread processes the first chunk.
+// The first exception thrown by any worker is rethrown after all have joined.
+template <typename Fn>
+void runPartitioned(size_t count, unsigned threads, Fn fn) {
+    // Below this many items per worker the thread start-up cost dominates
+    const size_t minChunk = 16384;
+    size_t workers = std::max<size_t>(1, std::min<size_t>(threads, count / minChunk));
+    if (workers == 1) {
+        fn(size_t(0), count);
+        return;
+    }
+    
+    std::vector<std::exception_ptr> errors(workers);
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    size_t chunk = (count + workers - 1) / workers;
+    for (size_t w = 1; w < workers; ++w) {
+        size_t begin = std::min(count, w * chunk);
+        size_t end = std::min(count, begin + chunk);
+        pool.emplace_back([&fn, &errors, w, begin, end]() {
+            try {
+                fn(begin, end);
+            } catch (...) {
+                errors[w] = std::current_exception();
+            }
+        });
+    }
+    try {
+        fn(size_t(0), std::min(count, chunk));
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+    for (auto& worker : pool) {
+        worker.join();
+    }
+    for (auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+// One entry of a batch handed to Bank::applyBatch
+enum class OperationType : uint8_t {
+    Deposit,
+    Withdraw
+};
+
+struct BatchOperation {
+    OperationType type;
+    std::string accountNumber;
+    Money amount;
+};
+
+// Outcome of Bank::openDataDirectory
+struct RecoveryStats {
+    bool ok = true;
+    std::string error;
+    bool snapshotLoaded = false;
+    uint64_t snapshotAccounts = 0;
+    uint64_t snapshotEntries = 0;
+    uint64_t replayedRecords = 0;
+    double seconds = 0;
+};
+
+// One account's share of a monthly interest run
+struct InterestCredit {
+    const SavingsAccount* account;
+    Money interest;
+    Money balance;   // right after the credit
+};
+
+// Optional observer of account activity made through a Bank (see
+// Bank::setEventSink). Called on the thread that performed the operation,
+// after the account locks are released and possibly before the operation
+// is durable, so implementations must be thread-safe and cheap.
+class AccountEventSink {
+public:
+    virtual ~AccountEventSink() = default;
+    virtual void onDeposit(const Account&, Money /*amount*/, const OperationResult&) {}
+    virtual void onWithdrawal(const Account&, Money /*amount*/, const OperationResult&) {}
+    // result carries the source account's balance and any fee it paid
+    virtual void onTransfer(const Account& /*from*/, const Account& /*to*/, Money /*amount*/, 
+                            const OperationResult&) {}
+    virtual void onInterest(const InterestCredit&) {}
+};
+
+// Operations timed by BankMetrics
+enum class MetricOperation : uint8_t {
+    FindAccount,
+    Deposit,
+    Withdraw,
+    Transfer,
+    Interest,
+    History,
+    CommitWait    // waiting for the write-ahead log to make a change durable
+};
+
+constexpr size_t metricOperationCount = 7;
+
+inline const char* metricOperationName(MetricOperation operation) {
+    static const char* const names[] = {
+        "find_account",
+        "deposit",
+        "withdraw",
+        "transfer",
+        "interest",
+        "history",
+        "commit_wait"
+    };
+    return names[static_cast<uint8_t>(operation)];
+}
+
+// Log-linear latency histogram in the style of HdrHistogram. Every power of
+// two of nanoseconds is split into 16 equal buckets, so a recorded value is
+// known to within 1/16 (6.25%); values below 32 ns are exact. Durations from
+// 2^40 ns (about 18 minutes) up land in the last bucket.
+class LatencyHistogram {
+public:
+    static constexpr unsigned subBucketBits = 4;
+    static constexpr unsigned subBucketCount = 1u << subBucketBits;
+    static constexpr unsigned maxExponent = 40;
+    static constexpr size_t bucketCount = (maxExponent - subBucketBits + 1) * subBucketCount;
+    
+private:
+    uint64_t counts[bucketCount] = {};
+    uint64_t total = 0;
+    uint64_t sumNanos = 0;
+    
+public:
+    static size_t bucketIndex(uint64_t nanos) {
+        nanos = std::min(nanos, (uint64_t(1) << maxExponent) - 1);
+        if (nanos < 2 * subBucketCount) return static_cast<size_t>(nanos);
+        unsigned shift = (63 - __builtin_clzll(nanos)) - subBucketBits;
+        return shift * subBucketCount + static_cast<size_t>(nanos >> shift);
+    }
+    
+    // Smallest value that falls into bucket index; the bucket ends where
+    // the next one starts
+    static uint64_t bucketLowerBound(size_t index) {
+        if (index < 2 * subBucketCount) return index;
+        unsigned shift = static_cast<unsigned>(index / subBucketCount) - 1;
+        return uint64_t(index - shift * subBucketCount) << shift;
+    }
+    
+    void add(size_t index, uint64_t count) {
+        counts[index] += count;
+        total += count;
+    }
+    
+    void addSum(uint64_t nanos) { sumNanos += nanos; }
+    
+    uint64_t getCount() const { return total; }
+    uint64_t getSumNanos() const { return sumNanos; }
+    
+    // Number of values below limit, exact when limit is a power of two
+    uint64_t countBelow(uint64_t limit) const {
+        uint64_t below = 0;
+        for (size_t i = 0; i < bucketCount && bucketLowerBound(i) < limit; ++i) {
+            below += counts[i];
+        }
+        return below;
+    }
+    
+    // Upper end of the bucket holding the q-th quantile, 0 if empty
+    uint64_t valueAtQuantile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * double(total))));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return i + 1 < bucketCount ? bucketLowerBound(i + 1) - 1 : bucketLowerBound(i);
+            }
+        }
+        return bucketLowerBound(bucketCount - 1);
+    }
+};
+
+// Latency histograms and outcome counters for bank operations.
+// Each thread records into a shard it leases from a ThreadSlotPool, so a
+// shard only ever has one writer and recording is a handful of plain
+// stores; readers merge every shard. A shard that goes back to the pool is
+// reused, counts included, by the next thread.
+// Timestamps come from the x86 time-stamp counter where available (Linux
+// only uses it as its clock source when it is invariant and synchronised
+// across cores), calibrated once against steady_clock.
+class BankMetrics {
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[metricOperationCount][LatencyHistogram::bucketCount];
+        std::atomic<uint64_t> sumNanos[metricOperationCount];
+        std::atomic<uint64_t> outcomes[metricOperationCount][operationStatusCount];
+    };
+    
+    ThreadSlotPool<Shard> shards;
+    
+    // Single writer, so no read-modify-write instruction is needed
+    static void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+    
+    static int64_t steadyNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    // Nanoseconds per tick of now(), measured over a few milliseconds the
+    // first time it is needed
+    static double nanosPerTick() {
+#if defined(__x86_64__)
+        static const double ratio = []() {
+            int64_t startNanos = steadyNanos();
+            uint64_t startTicks = __rdtsc();
+            while (steadyNanos() - startNanos < 5000000) {
+            }
+            return double(steadyNanos() - startNanos) / double(__rdtsc() - startTicks);
+        }();
+        return ratio;
+#else
+        return 1.0;
+#endif
+    }
+    
+public:
+    BankMetrics() {
+        nanosPerTick();
+    }
+    
+    BankMetrics(const BankMetrics&) = delete;
+    BankMetrics& operator=(const BankMetrics&) = delete;
+    
+    // Timestamp in clock ticks, for recordSince and recordInterval
+    static int64_t now() {
+#if defined(__x86_64__)
+        return static_cast<int64_t>(__rdtsc());
+#else
+        return steadyNanos();
+#endif
+    }
+    
+    void record(MetricOperation operation, OperationStatus status, int64_t nanos) {
+        Shard& shard = shards.local();
+        size_t op = static_cast<size_t>(operation);
+        uint64_t value = nanos > 0 ? uint64_t(nanos) : 0;
+        bump(shard.buckets[op][LatencyHistogram::bucketIndex(value)], 1);
+        bump(shard.sumNanos[op], value);
+        bump(shard.outcomes[op][static_cast<size_t>(status)], 1);
+    }
+    
+    // Records the time between two timestamps taken with now()
+    void recordInterval(MetricOperation operation, OperationStatus status, int64_t start, int64_t end) {
+        record(operation, status, static_cast<int64_t>(double(end - start) * nanosPerTick()));
+    }
+    
+    void recordSince(MetricOperation operation, OperationStatus status, int64_t start) {
+        recordInterval(operation, status, start, now());
+    }
+    
+    LatencyHistogram histogram(MetricOperation operation) const;
+    
+    uint64_t outcomeCount(MetricOperation operation, OperationStatus status) const;
+    
+    // Prometheus text exposition format. Histogram buckets are reported at
+    // every other power of two nanoseconds from 64 ns to about 69 s, where
+    // the fine buckets line up exactly; quantiles come from the fine buckets.
+    void writePrometheus(std::ostream& out) const;
+    
+    // Replaces path with a fresh snapshot. The file is written beside it and
+    // renamed into place, so a collector never reads half a snapshot.
+    bool writePrometheusFile(const std::string& path) const;
+};
+
+// Bank class to manage multiple accounts
+class Bank {
+private:
+    Ledger ledger;
+    std::unique_ptr<WriteAheadLog> journal;
+    // Accounts and their names live in arenas: creating one costs a couple
+    // of pointer bumps instead of several heap allocations, accounts sit
+    // next to each other in creation order, and destroying the bank frees
+    // them slab by slab. Names are kept apart from the cache-line aligned
+    // accounts so they pack without padding.
+    Arena accountArena;
+    Arena nameArena;
+    ProductCatalog products;
+    std::vector<Account*> accounts;
+    std::vector<SavingsAccount*> savingsAccounts;
+    AccountIndex accountIndex;
+    // Serializes account creation, whole-bank walks and the interest run.
+    // Per-account operations never take it.
+    mutable std::mutex accountsMutex;
+    SavingsInterestStore interestStore;
+    AccountEventSink* eventSink = nullptr;
+    BankMetrics* metrics = nullptr;
+    unsigned interestThreads = 1;
+    std::string bankName;
+    std::string dataDirectory;
+    uint64_t checkpointInterval = 0;
+    uint64_t checkpointLsn = 0;   // newest log record covered by the snapshot
+    
+    static constexpr char snapshotMagic[8] = {'B', 'A', 'N', 'K', 'S', 'N', 'P', '1'};
+    
+    uint32_t nextAccountId() const { return static_cast<uint32_t>(accounts.size()); }
+    
+    // Creates an account of type T in the arena. Nobody else can reach it
+    // until indexAccount. Caller holds accountsMutex (or has the bank to
+    // itself during recovery) and has checked that the number is free.
+    template <typename T, typename... Args>
+    T* createAccount(std::string_view accNum, std::string_view holderName, Args&&... args) {
+        return accountArena.create<T>(ledger, nextAccountId(), nameArena.copy(accNum), 
+                                      nameArena.copy(holderName), std::forward<Args>(args)...);
+    }
+    
+    Account* createAccountOn(const ProductDefinition& product, std::string_view accNum, 
+                             std::string_view holderName, Money initialBalance) {
+        switch (product.getKind()) {
+            case AccountKind::Savings:
+                return createAccount<SavingsAccount>(accNum, holderName, product, initialBalance);
+            case AccountKind::Current:
+                return createAccount<CurrentAccount>(accNum, holderName, product, initialBalance);
+        }
+        std::abort();
+    }
+    
+    // Makes a created account visible to lookups and bank-wide operations
+    void indexAccount(Account& account) {
+        accounts.push_back(&account);
+        if (auto* savings = accountCast<SavingsAccount>(&account)) {
+            savingsAccounts.push_back(savings);
+        }
+        accountIndex.insert(&account);
+    }
+    
+    // Opens an account on a product, without waiting for durability
+    OperationStatus openAccount(const std::string& accNum, const std::string& holderName, 
+                                uint16_t productId, Money initialBalance) {
+        // The log records only positive opening deposits, so a negative
+        // opening balance could not be recovered
+        if (initialBalance < Money()) return OperationStatus::InvalidAmount;
+        std::lock_guard<std::mutex> lock(accountsMutex);
+        if (accountIndex.find(accNum)) return OperationStatus::AccountExists;
+        // Journaled once construction has succeeded, so a failure leaves
+        // nothing in the log, and before the account is indexed, so no
+        // operation on it can reach the log ahead of its creation
+        Account* account = createAccountOn(*products.find(productId), accNum, holderName, 
+                                           initialBalance);
+        journalAccountCreation(*account);
+        indexAccount(*account);
+        return OperationStatus::Ok;
+    }
+    
+    // Logs a new account and its opening deposit as one record, so replay
+    // never recreates the account without its opening balance. Record
+    // layout: account id, number, holder name, product id, opening
+    // balance, and the opening entry's timestamp (0 if there is none).
+    void journalAccountCreation(Account& account) {
+        if (!journal) return;
+        std::string payload;
+        ByteWriter writer(payload);
+        writer.put<uint32_t>(account.getAccountId());
+        writer.putString(account.getAccountNumber());
+        writer.putString(account.getHolderName());
+        writer.put<uint16_t>(account.getProduct().getId());
+        bool opened = account.getEntryCount() > 0;
+        writer.put<int64_t>(account.getBalanceLocked().getCents());
+        writer.put<int64_t>(opened ? ledger.at(account.getLastEntry()).getTimestampNanos() : 0);
+        account.setPendingLsn(journal->append(WalRecordType::CreateAccount, payload));
+    }
+    
+    // Product record layout, shared by the log and snapshots: id, kind,
+    // interest rate, minimum balance, overdraft limit, overdraft fee
+    static void encodeProduct(uint16_t id, AccountKind kind, const ProductParameters& parameters, 
+                              std::string& out) {
+        ByteWriter writer(out);
+        writer.put<uint16_t>(id);
+        writer.put<uint8_t>(static_cast<uint8_t>(kind));
+        writer.put<double>(parameters.interestRate);
+        writer.put<int64_t>(parameters.minimumBalance.getCents());
+        writer.put<int64_t>(parameters.overdraftLimit.getCents());
+        writer.put<int64_t>(parameters.overdraftFee.getCents());
+    }
+    
+    // Recovery: applies a product record to the catalog
+    bool restoreProduct(ByteReader& reader) {
+        uint16_t id = reader.get<uint16_t>();
+        uint8_t kind = reader.get<uint8_t>();
+        ProductParameters parameters;
+        parameters.interestRate = reader.get<double>();
+        parameters.minimumBalance = Money::fromCents(reader.get<int64_t>());
+        parameters.overdraftLimit = Money::fromCents(reader.get<int64_t>());
+        parameters.overdraftFee = Money::fromCents(reader.get<int64_t>());
+        if (!reader.ok() || kind > static_cast<uint8_t>(AccountKind::Current)) return false;
+        return products.define(id, static_cast<AccountKind>(kind), parameters) != nullptr;
+    }
+    
+    void journalProduct(uint16_t id, AccountKind kind, const ProductParameters& parameters) {
+        if (!journal) return;
+        std::string payload;
+        encodeProduct(id, kind, parameters, payload);
+        journal->append(WalRecordType::DefineProduct, payload);
+    }
+    
+    // Logs every product, so the log alone is enough to recover the
+    // parameters of the accounts created in it
+    void journalProducts() {
+        products.forEach([&](const ProductDefinition& product) {
+            journalProduct(product.getId(), product.getKind(), product.getParameters());
+        });
+    }
+    
+    std::string snapshotPath() const { return dataDirectory + "/bank.snapshot"; }
+    std::string walPath() const { return dataDirectory + "/bank.wal"; }
+    
+    static bool syncPath(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        bool synced = fsync(fd) == 0;
+        ::close(fd);
+        return synced;
+    }
+    
+    // Credits one month of interest to every savings account and waits
+    // until the credits are durable. Caller holds accountsMutex.
+    void creditMonthlyInterestLocked();
+    
+    // The locked part of a transfer between two different accounts;
+    // the result describes the source account
+    OperationResult moveFunds(Account& from, Account& to, Money amount) {
+        Account& first = from.getAccountId() < to.getAccountId() ? from : to;
+        Account& second = &first == &from ? to : from;
+        std::lock_guard<std::mutex> firstLock(first.getMutex());
+        std::lock_guard<std::mutex> secondLock(second.getMutex());
+        
+        Money fee;
+        OperationStatus status = from.checkWithdrawal(amount, fee);
+        if (status != OperationStatus::Ok) {
+            return OperationResult{status, from.getBalanceLocked()};
+        }
+        // Overflow throws here rather than after the entries are reserved,
+        // which would leave them unwritten
+        static_cast<void>(from.getBalanceLocked() - amount - fee);
+        static_cast<void>(to.getBalanceLocked() + amount);
+        // Entries: Transfer Out, optional Overdraft Fee, Transfer In
+        uint64_t entries = fee > Money() ? 3 : 2;
+        uint64_t outEntry = ledger.reserve(entries);
+        uint64_t inEntry = outEntry + entries - 1;
+        int64_t timestamp = CoarseClock::nowNanos();
+        from.applyTransferOut(amount, fee, outEntry, inEntry, timestamp);
+        to.applyTransferIn(amount, inEntry, outEntry, timestamp);
+        uint64_t lsn = ledger.journalRange(outEntry, entries);
+        from.setPendingLsn(lsn);
+        to.setPendingLsn(lsn);
+        return OperationResult{OperationStatus::Ok, from.getBalanceLocked(), fee};
+    }
+    
+    // Makes a successful operation on account durable before it is reported
+    OperationResult commitResult(Account* account, OperationResult result) {
+        if (result.status == OperationStatus::Ok) {
+            commitAccount(*account);
+        }
+        return result;
+    }
+    
+    // Deposit, withdrawal and transfer on accounts already looked up (null
+    // where there is none), so the durable paths probe the index only once.
+    // start is when the operation began, lookup included.
+    OperationResult applyDepositTo(Account* account, Money amount, int64_t start) {
+        OperationResult result{OperationStatus::AccountNotFound, Money()};
+        if (account) {
+            result = account->applyDeposit(amount);
+            if (eventSink) eventSink->onDeposit(*account, amount, result);
+        }
+        if (metrics) metrics->recordSince(MetricOperation::Deposit, result.status, start);
+        return result;
+    }
+    
+    OperationResult applyWithdrawalFrom(Account* account, Money amount, int64_t start) {
+        OperationResult result{OperationStatus::AccountNotFound, Money()};
+        if (account) {
+            result = account->applyWithdrawal(amount);
+            if (eventSink) eventSink->onWithdrawal(*account, amount, result);
+        }
+        if (metrics) metrics->recordSince(MetricOperation::Withdraw, result.status, start);
+        return result;
+    }
+    
+    OperationStatus applyTransferBetween(Account* from, Account* to, Money amount, int64_t start) {
+        OperationStatus status = OperationStatus::AccountNotFound;
+        if (from && to) {
+            OperationResult result = from == to ? OperationResult{OperationStatus::SameAccount, Money()}
+                                                : moveFunds(*from, *to, amount);
+            if (eventSink) eventSink->onTransfer(*from, *to, amount, result);
+            status = result.status;
+        }
+        if (metrics) metrics->recordSince(MetricOperation::Transfer, status, start);
+        return status;
+    }
+    
+    // Waits until the account's transactions are durable, timing the wait
+    // when a write-ahead log is in use
+    void commitAccount(Account& account) {
+        if (!metrics || !journal) {
+            account.commitTransactions();
+            return;
+        }
+        int64_t start = BankMetrics::now();
+        account.commitTransactions();
+        metrics->recordSince(MetricOperation::CommitWait, OperationStatus::Ok, start);
+    }
+    
+    // Recreates an empty account from a creation record or snapshot entry,
+    // reading its product id from the reader
+    Account* restoreAccount(const std::string& accNum, const std::string& holderName, 
+                            ByteReader& reader) {
+        if (accountIndex.find(accNum)) return nullptr;
+        uint16_t productId = reader.get<uint16_t>();
+        if (!reader.ok()) return nullptr;
+        const ProductDefinition* product = products.find(productId);
+        if (!product) return nullptr;
+        Account* account = createAccountOn(*product, accNum, holderName, Money());
+        indexAccount(*account);
+        return account;
+    }
+    
+    // Snapshot layout: magic, covered LSN, account count, product count and
+    // product records, account records in length-prefixed blocks of about
+    // 1 MiB, the ledger, and the magic again as an end marker. Written to a
+    // temporary file and renamed into place.
+    bool writeSnapshot(const std::string& path, uint64_t lsn) const;
+    
+    // Loads a snapshot into this (empty) bank. A missing file is not an error.
+    bool readSnapshot(const std::string& path, RecoveryStats& stats);
+    
+    // Re-applies log records newer than the snapshot and reports where the
+    // log's intact records end, for reopening it without another scan
+    bool replayLog(const std::string& path, RecoveryStats& stats, WriteAheadLog::Tail& tail);
+    
+public:
+    // Every bank starts with the standard savings and current products
+    static constexpr uint16_t savingsProductId = 0;
+    static constexpr uint16_t currentProductId = 1;
+    
+    Bank(const std::string& name) : bankName(name) {
+        products.add(AccountKind::Savings, SavingsProduct::defaultParameters);
+        products.add(AccountKind::Current, CurrentProduct::defaultParameters);
+    }
+    Bank(const Bank&) = delete;
+    Bank& operator=(const Bank&) = delete;
+    
+    // The arenas release the memory; only the destructors run per account
+    ~Bank() {
+        for (Account* account : accounts) {
+            visitAccount(*account, [](auto& concrete) { std::destroy_at(&concrete); });
+        }
+    }
+    
+    // Makes account creation and every ledger entry durable in a binary
+    // write-ahead log at path before the operation is acknowledged
+    bool enableWriteAheadLog(const std::string& path, 
+                             GroupCommitPolicy policy = GroupCommitPolicy());
+    
+    // Makes the bank durable in dir (created if missing): loads the latest
+    // snapshot, replays only the log records written after it, then keeps
+    // logging to the same directory. A checkpoint is due every
+    // checkpointEvery log records (0 disables automatic checkpoints).
+    // Must be called on a bank with no accounts.
+    RecoveryStats openDataDirectory(const std::string& dir, 
+                                    GroupCommitPolicy policy = GroupCommitPolicy(),
+                                    uint64_t checkpointEvery = 100000);
+    
+    // Writes a snapshot of every account and the ledger, then discards the
+    // log records it covers. Must not run concurrently with other operations.
+    bool checkpoint();
+    
+    // Checkpoints once enough log records have accumulated
+    bool checkpointIfDue() {
+        if (!journal || checkpointInterval == 0 || 
+            journal->lastLsn() - checkpointLsn < checkpointInterval) {
+            return true;
+        }
+        return checkpoint();
+    }
+    
+    bool isPersistent() const { return !dataDirectory.empty(); }
+    
+    // Accounts can be opened concurrently, so this takes the lock that
+    // serialises their creation
+    size_t getAccountCount() const {
+        std::lock_guard<std::mutex> lock(accountsMutex);
+        return accounts.size();
+    }
+    
+    // Moves amount between two accounts atomically. Both accounts are locked
+    // in account-id order, so concurrent transfers cannot deadlock. The
+    // source's product rules apply as for a withdrawal (minimum balance, or
+    // overdraft limit plus fee), and the two sides are recorded as linked
+    // Transfer Out / Transfer In entries logged in one all-or-nothing record.
+    OperationStatus transfer(std::string_view fromAccNum, std::string_view toAccNum, 
+                             Money amount) {
+        int64_t start = metrics ? BankMetrics::now() : 0;
+        Account* from = accountIndex.find(fromAccNum);
+        OperationStatus status = applyTransferBetween(from, accountIndex.find(toAccNum), 
+                                                      amount, start);
+        if (status == OperationStatus::Ok) {
+            commitAccount(*from);
+        }
+        return status;
+    }
+    
+    // Deposits and withdrawals by account number. They return once the
+    // transaction is durable and never print; the caller reports the result.
+    OperationResult deposit(std::string_view accNum, Money amount) {
+        int64_t start = metrics ? BankMetrics::now() : 0;
+        Account* account = accountIndex.find(accNum);
+        return commitResult(account, applyDepositTo(account, amount, start));
+    }
+    
+    OperationResult withdraw(std::string_view accNum, Money amount) {
+        int64_t start = metrics ? BankMetrics::now() : 0;
+        Account* account = accountIndex.find(accNum);
+        return commitResult(account, applyWithdrawalFrom(account, amount, start));
+    }
+    
+    // Like deposit and withdraw, but without waiting for durability
+    OperationResult applyDeposit(std::string_view accNum, Money amount) {
+        int64_t start = metrics ? BankMetrics::now() : 0;
+        return applyDepositTo(accountIndex.find(accNum), amount, start);
+    }
+    
+    OperationResult applyWithdrawal(std::string_view accNum, Money amount) {
+        int64_t start = metrics ? BankMetrics::now() : 0;
+        return applyWithdrawalFrom(accountIndex.find(accNum), amount, start);
+    }
+    
+    // Like transfer, but returns without waiting for durability
+    OperationStatus applyTransfer(std::string_view fromAccNum, std::string_view toAccNum, 
+                                  Money amount) {
+        int64_t start = metrics ? BankMetrics::now() : 0;
+        return applyTransferBetween(accountIndex.find(fromAccNum), accountIndex.find(toAccNum), 
+                                    amount, start);
+    }
+    
+    // Applies many deposits and withdrawals without printing. Operations are
+    // grouped by account so each account is touched in one burst, while the
+    // operations of any one account still run in their original order.
+    // Everything is made durable with a single log commit at the end.
+    std::vector<OperationResult> applyBatch(std::span<const BatchOperation> operations) {
+        std::vector<OperationResult> results(operations.size(), 
+                                             OperationResult{OperationStatus::AccountNotFound, Money()});
+        // (account id, operation index, account) triples; sorting them groups
+        // by account and keeps the original order inside each group
+        struct Step {
+            uint32_t id;
+            uint32_t index;
+            Account* account;
+        };
+        std::vector<Step> order;
+        order.reserve(operations.size());
+        for (size_t i = 0; i < operations.size(); ++i) {
+            if (Account* account = accountIndex.find(operations[i].accountNumber)) {
+                order.push_back(Step{account->getAccountId(), static_cast<uint32_t>(i), account});
+            }
+        }
+        std::sort(order.begin(), order.end(), [](const Step& a, const Step& b) {
+            return a.id != b.id ? a.id < b.id : a.index < b.index;
+        });
+        
+        // With metrics on, each operation is timed from the end of the
+        // previous one, so the batch costs one clock read per operation
+        int64_t start = metrics ? BankMetrics::now() : 0;
+        for (const Step& step : order) {
+            const BatchOperation& operation = operations[step.index];
+            OperationResult& result = results[step.index];
+            MetricOperation metric;
+            if (operation.type == OperationType::Deposit) {
+                result = step.account->applyDeposit(operation.amount);
+                if (eventSink) eventSink->onDeposit(*step.account, operation.amount, result);
+                metric = MetricOperation::Deposit;
+            } else {
+                result = step.account->applyWithdrawal(operation.amount);
+                if (eventSink) eventSink->onWithdrawal(*step.account, operation.amount, result);
+                metric = MetricOperation::Withdraw;
+            }
+            if (metrics) {
+                int64_t end = BankMetrics::now();
+                metrics->recordInterval(metric, result.status, start, end);
+                start = end;
+            }
+        }
+        commitJournal();
+        return results;
+    }
+    
+    // Waits until everything logged so far is durable
+    void commitJournal() {
+        if (!journal) return;
+        int64_t start = metrics ? BankMetrics::now() : 0;
+        journal->waitDurable(journal->lastLsn());
+        if (metrics) metrics->recordSince(MetricOperation::CommitWait, OperationStatus::Ok, start);
+    }
+    
+    // Account creation returns once the new account is durable
+    OperationStatus createSavingsAccount(const std::string& accNum, const std::string& holderName, 
+                                         Money initialBalance = Money()) {
+        OperationStatus status = openSavingsAccount(accNum, holderName, initialBalance);
+        if (status == OperationStatus::Ok) commitJournal();
+        return status;
+    }
+    
+    OperationStatus createCurrentAccount(const std::string& accNum, const std::string& holderName, 
+                                         Money initialBalance = Money()) {
+        OperationStatus status = openCurrentAccount(accNum, holderName, initialBalance);
+        if (status == OperationStatus::Ok) commitJournal();
+        return status;
+    }
+    
+    // Like the create functions, but without waiting for durability.
+    // The number is checked before constructing the account so
+    // a rejected account never writes its initial deposit to the ledger.
+    OperationStatus openSavingsAccount(const std::string& accNum, const std::string& holderName, 
+                                       Money initialBalance = Money()) {
+        return openAccount(accNum, holderName, savingsProductId, initialBalance);
+    }
+    
+    OperationStatus openCurrentAccount(const std::string& accNum, const std::string& holderName, 
+                                       Money initialBalance = Money()) {
+        return openAccount(accNum, holderName, currentProductId, initialBalance);
+    }
+    
+    // The bank's products. Products are only added during recovery, so
+    // after that the catalog can be read while the bank is in use.
+    const ProductCatalog& getProducts() const { return products; }
+    
+    // Changes a product's parameters for every account opened on it in one
+    // update; the change is durable before this returns. Operations running
+    // meanwhile may still use the old values. Returns false if there is no
+    // such product.
+    bool setProductParameters(uint16_t productId, const ProductParameters& parameters) {
+        {
+            std::lock_guard<std::mutex> lock(accountsMutex);
+            ProductDefinition* product = products.find(productId);
+            if (!product) return false;
+            journalProduct(productId, product->getKind(), parameters);
+            product->setParameters(parameters);
+        }
+        commitJournal();
+        return true;
+    }
+    
+    // Receives every operation made through this bank; null disables.
+    // Set it before the bank is shared between threads.
+    void setEventSink(AccountEventSink* sink) { eventSink = sink; }
+    
+    // Records latency histograms and outcome counts of operations made
+    // through this bank; null disables. Set it before the bank is shared
+    // between threads.
+    void setMetrics(BankMetrics* bankMetrics) { metrics = bankMetrics; }
+    BankMetrics* getMetrics() const { return metrics; }
+    
+    // Lock-free; safe to call concurrently with account creation
+    Account* findAccount(std::string_view accNum) {
+        if (!metrics) return accountIndex.find(accNum);
+        int64_t start = BankMetrics::now();
+        Account* account = accountIndex.find(accNum);
+        metrics->recordSince(MetricOperation::FindAccount, 
+                             account ? OperationStatus::Ok : OperationStatus::AccountNotFound, start);
+        return account;
+    }
+    
+    // Calls fn for every account in creation order; accounts created
+    // meanwhile wait until the walk is done
+    template <typename Fn>
+    void forEachAccount(Fn fn) const {
+        std::lock_guard<std::mutex> lock(accountsMutex);
+        for (const auto& account : accounts) {
+            fn(*account);
+        }
+    }
+    
+    // Credits one month of interest to every savings account and returns
+    // each account's credit in creation order
+    std::vector<InterestCredit> applyMonthlyInterest();
+    
+    // Like applyMonthlyInterest, but only returns the number of accounts
+    // credited
+    size_t creditMonthlyInterest() {
+        std::lock_guard<std::mutex> lock(accountsMutex);
+        creditMonthlyInterestLocked();
+        return savingsAccounts.size();
+    }
+    
+    // Number of worker threads used by the monthly interest run.
+    // Zero selects one per hardware thread.
+    void setInterestThreads(unsigned threads) {
+        interestThreads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    unsigned getInterestThreads() const { return interestThreads; }
+    
+    // Writes the whole transaction ledger as CSV; account_id is the
+    // position of the account in creation order
+    bool exportTransactions(const std::string& path) const;
+    
+    std::string getBankName() const { return bankName; }
+};
+
+// Bounded lock-free queue for many producers and one consumer. Each slot
+// carries a sequence number telling whether it is free for the producer
+// of a given position or filled for the consumer, so a push is one CAS on
+// the shared head plus a copy into the slot.
+template <typename T>
+class MpscRing {
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence;
+        T value;
+    };
+    
+    std::unique_ptr<Slot[]> slots;
+    uint64_t mask;
+    alignas(64) std::atomic<uint64_t> head{0};   // next position to claim
+    alignas(64) uint64_t tail = 0;               // consumer only
+    
+public:
+    // capacity is rounded up to a power of two
+    explicit MpscRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    
+    // Safe from any thread; false if the ring is full
+    bool tryPush(const T& value) {
+        uint64_t position = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[position & mask];
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            int64_t lag = int64_t(sequence - position);
+            if (lag == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lag < 0) {
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    // Consumer thread only; false if nothing is ready
+    bool tryPop(T& value) {
+        Slot& slot = slots[tail & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+            return false;
+        }
+        value = slot.value;
+        slot.sequence.store(tail + mask + 1, std::memory_order_release);
+        ++tail;
+        return true;
+    }
+};
+
+// What ActivityLogger does when its ring is full
+enum class OverflowPolicy : uint8_t {
+    Drop,    // discard the event and count it
+    Block    // wait for the writer thread to make room
+};
+
+// Human-readable activity log fed by the bank's event sink. Producers only
+// copy a small binary record into a lock-free ring; a background thread
+// formats the records and writes them to the file in large chunks.
+class ActivityLogger : public AccountEventSink {
+public:
+    enum class Kind : uint8_t {
+        Deposit,
+        Withdrawal,
+        OverdraftFee,
+        Interest,
+        Transfer
+    };
+    
+    struct Record {
+        int64_t timestamp;
+        const Account* account;
+        const Account* counterpart;   // destination of a transfer
+        int64_t amount;
+        int64_t balance;
+        Kind kind;
+        OperationStatus status;
+    };
+    
+private:
+    static constexpr size_t writeChunk = 1 << 16;
+    
+    MpscRing<Record> ring;
+    OverflowPolicy policy;
+    int fd = -1;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> stopping{false};
+    std::string pending;     // formatted text not yet written; writer thread only
+    int64_t cachedSecond = -1;
+    char cachedTime[24];     // "2026-10-15T21:04:05" for cachedSecond
+    std::thread writer;
+    
+    void push(const Record& record) {
+        if (ring.tryPush(record)) return;
+        if (policy == OverflowPolicy::Drop) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        while (!ring.tryPush(record)) {
+            std::this_thread::yield();
+        }
+    }
+    
+    void record(Kind kind, const Account& account, const Account* counterpart, Money amount, 
+                Money balance, OperationStatus status) {
+        push(Record{CoarseClock::nowNanos(), &account, counterpart, amount.getCents(), 
+                    balance.getCents(), kind, status});
+    }
+    
+    static const char* kindName(Kind kind) {
+        static const char* const names[] = {"Deposit", "Withdrawal", "OverdraftFee", "Interest", "Transfer"};
+        return names[static_cast<uint8_t>(kind)];
+    }
+    
+    // e.g. "2026-10-15T21:04:05.123Z Withdrawal ACC1 25.00 balance 475.00"
+    void format(const Record& record);
+    
+    void writePending();
+    
+    void run();
+    
+public:
+    ActivityLogger(size_t capacity, OverflowPolicy overflow) : ring(capacity), policy(overflow) {}
+    
+    ~ActivityLogger() { close(); }
+    
+    ActivityLogger(const ActivityLogger&) = delete;
+    ActivityLogger& operator=(const ActivityLogger&) = delete;
+    
+    // Appends to path and starts the writer thread
+    bool open(const std::string& path);
+    
+    // Writes every event logged so far and stops the writer thread. The
+    // logger must be detached from the bank (or the bank idle) first.
+    void close();
+    
+    uint64_t getDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    
+    void onDeposit(const Account& account, Money amount, const OperationResult& result) override {
+        record(Kind::Deposit, account, nullptr, amount, result.balance, result.status);
+    }
+    
+    void onWithdrawal(const Account& account, Money amount, const OperationResult& result) override {
+        record(Kind::Withdrawal, account, nullptr, amount, result.balance, result.status);
+        if (result.fee > Money()) {
+            record(Kind::OverdraftFee, account, nullptr, result.fee, result.balance, result.status);
+        }
+    }
+    
+    void onTransfer(const Account& from, const Account& to, Money amount, 
+                    const OperationResult& result) override {
+        record(Kind::Transfer, from, &to, amount, result.balance, result.status);
+        if (result.fee > Money()) {
+            record(Kind::OverdraftFee, from, nullptr, result.fee, result.balance, result.status);
+        }
+    }
+    
+    void onInterest(const InterestCredit& credit) override {
+        record(Kind::Interest, *credit.account, nullptr, credit.interest, credit.balance, 
+               OperationStatus::Ok);
+    }
+};
+
+#endif
@@ -1,288 +1,932 @@
-#include <iostream>
-#include <string>
-#include <vector>
-#include <memory>
-#include <iomanip>
-#include <ctime>
-#include <algorithm>
+#include "banking_core.h"
+#include "bank_protocol.h"
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <csignal>
+#include <unordered_map>
 
-// Transaction class to store transaction history
-class Transaction {
+// Single-threaded network front end for a Bank, speaking the binary
+// protocol in bank_protocol.h over a Unix domain socket and/or a loopback
+// TCP port. One epoll loop serves every connection. Each loop iteration
+// executes all complete request frames that have arrived, makes their
+// effects durable with a single log commit, and only then sends the
+// responses, so pipelined requests from all clients share one group commit.
+class BankServer {
 private:
-    std::string type;
-    double amount;
-    double balanceAfter;
-    std::string timestamp;
+    struct Connection {
+        int fd;
+        std::string input;
+        std::string output;
+        size_t outputSent = 0;
+        uint32_t events = 0;      // currently registered with epoll
+        bool readPaused = false;  // too much unsent output
+        bool peerClosed = false;
+        bool broken = false;
+        bool queued = false;      // in the flush list of this iteration
+    };
     
-public:
-    Transaction(const std::string& t, double amt, double balance) 
-        : type(t), amount(amt), balanceAfter(balance) {
-        // Get current timestamp
-        time_t now = time(0);
-        timestamp = ctime(&now);
-        timestamp.pop_back(); // Remove newline
-    }
+    static constexpr size_t readChunk = 1 << 16;
+    static constexpr int readsPerEvent = 16;
+    static constexpr size_t maxPendingOutput = 1 << 22;
+    
+    Bank& bank;
+    int epollFd = -1;
+    int signalFd = -1;
+    std::vector<int> listeners;
+    std::string unixPath;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::vector<Connection*> flushList;
+    std::unique_ptr<char[]> readBuffer;
+    std::string error;
+    bool mutated = false;   // some request in this iteration changed state
+    
+    static_assert(static_cast<uint8_t>(OperationStatus::AccountExists) == 
+                  static_cast<uint8_t>(ResponseStatus::AccountExists),
+                  "ResponseStatus must mirror OperationStatus");
     
-    void display() const {
-        std::cout << std::fixed << std::setprecision(2);
-        std::cout << "Type: " << type << " | Amount: $" << amount 
-                  << " | Balance: $" << balanceAfter << " | Time: " << timestamp << std::endl;
+    static ResponseStatus toResponseStatus(OperationStatus status) {
+        return static_cast<ResponseStatus>(status);
     }
     
-    std::string getType() const { return type; }
-    double getAmount() const { return amount; }
-    std::string getTimestamp() const { return timestamp; }
-};
-
-// Abstract base class Account
-class Account {
-protected:
-    std::string accountNumber;
-    std::string holderName;
-    double balance;
-    std::vector<Transaction> transactionHistory;
+    bool fail(const std::string& what) {
+        error = what + ": " + std::strerror(errno);
+        return false;
+    }
     
-public:
-    Account(const std::string& accNum, const std::string& name, double initialBalance = 0.0)
-        : accountNumber(accNum), holderName(name), balance(initialBalance) {
-        if (initialBalance > 0) {
-            transactionHistory.push_back(Transaction("Initial Deposit", initialBalance, balance));
+    bool addListener(int fd) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (::listen(fd, SOMAXCONN) != 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            ::close(fd);
+            return fail("listen");
         }
+        listeners.push_back(fd);
+        return true;
     }
     
-    virtual ~Account() = default;
+    bool isListener(int fd) const {
+        return std::find(listeners.begin(), listeners.end(), fd) != listeners.end();
+    }
     
-    // Pure virtual functions making this an abstract class
-    virtual void deposit(double amount) = 0;
-    virtual bool withdraw(double amount) = 0;
-    virtual void displayAccountInfo() const = 0;
-    virtual std::string getAccountType() const = 0;
+    void acceptConnections(int listenFd) {
+        for (;;) {
+            int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;   // EAGAIN, or a transient error on this attempt
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // fails harmlessly on Unix sockets
+            auto connection = std::make_unique<Connection>();
+            connection->fd = fd;
+            connection->events = EPOLLIN;
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ::close(fd);
+                continue;
+            }
+            connections.emplace(fd, std::move(connection));
+        }
+    }
     
-    // Common methods for all account types
-    double getBalance() const { return balance; }
-    std::string getAccountNumber() const { return accountNumber; }
-    std::string getHolderName() const { return holderName; }
+    void queueFlush(Connection& connection) {
+        if (!connection.queued) {
+            connection.queued = true;
+            flushList.push_back(&connection);
+        }
+    }
     
-    void displayTransactionHistory() const {
-        std::cout << "\n=== Transaction History for " << accountNumber << " ===" << std::endl;
-        if (transactionHistory.empty()) {
-            std::cout << "No transactions found." << std::endl;
-            return;
+    void readRequests(Connection& connection) {
+        for (int i = 0; i < readsPerEvent; ++i) {
+            ssize_t n = ::read(connection.fd, readBuffer.get(), readChunk);
+            if (n > 0) {
+                connection.input.append(readBuffer.get(), size_t(n));
+                if (size_t(n) < readChunk) break;
+            } else if (n == 0) {
+                connection.peerClosed = true;
+                break;
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) connection.broken = true;
+                break;
+            }
         }
         
-        for (const auto& transaction : transactionHistory) {
-            transaction.display();
+        size_t offset = 0;
+        while (!connection.broken) {
+            size_t frameSize = completeFrameSize(connection.input.data() + offset, 
+                                                 connection.input.size() - offset);
+            if (frameSize == 0) break;
+            if (frameSize == SIZE_MAX) {
+                // Framing is lost; nothing after this point can be trusted
+                connection.broken = true;
+                break;
+            }
+            handleRequest(connection.input.data() + offset + sizeof(uint32_t), 
+                          frameSize - sizeof(uint32_t), connection.output);
+            offset += frameSize;
         }
+        connection.input.erase(0, offset);
+        queueFlush(connection);
     }
     
-    void addTransaction(const std::string& type, double amount) {
-        transactionHistory.push_back(Transaction(type, amount, balance));
+    // Executes one request frame (without its length field) and appends
+    // the response frame to out
+    void handleRequest(const char* data, size_t size, std::string& out) {
+        FrameReader reader(data, size);
+        uint32_t requestId = reader.get<uint32_t>();
+        auto type = static_cast<RequestType>(reader.get<uint8_t>());
+        
+        switch (type) {
+            case RequestType::OpenSavings:
+            case RequestType::OpenCurrent: {
+                std::string_view accNum = reader.getShortString();
+                Money initialBalance = Money::fromCents(reader.get<int64_t>());
+                std::string_view holderName = reader.getShortString();
+                if (!reader.ok() || !reader.atEnd() || accNum.empty()) break;
+                OperationStatus status = initialBalance < Money() 
+                    ? OperationStatus::InvalidAmount
+                    : type == RequestType::OpenSavings
+                        ? bank.openSavingsAccount(std::string(accNum), std::string(holderName), initialBalance)
+                        : bank.openCurrentAccount(std::string(accNum), std::string(holderName), initialBalance);
+                mutated = true;
+                respond(out, requestId, toResponseStatus(status));
+                return;
+            }
+            
+            case RequestType::Deposit:
+            case RequestType::Withdraw: {
+                std::string_view accNum = reader.getShortString();
+                Money amount = Money::fromCents(reader.get<int64_t>());
+                if (!reader.ok() || !reader.atEnd()) break;
+                OperationResult result = type == RequestType::Deposit 
+                    ? bank.applyDeposit(accNum, amount) : bank.applyWithdrawal(accNum, amount);
+                mutated = true;
+                respondWithBalance(out, requestId, result.status, result.balance);
+                return;
+            }
+            
+            case RequestType::Balance: {
+                std::string_view accNum = reader.getShortString();
+                if (!reader.ok() || !reader.atEnd()) break;
+                Account* account = bank.findAccount(accNum);
+                if (!account) {
+                    respond(out, requestId, ResponseStatus::AccountNotFound);
+                    return;
+                }
+                respondWithBalance(out, requestId, OperationStatus::Ok, account->getBalance());
+                return;
+            }
+            
+            case RequestType::Transfer: {
+                std::string_view fromAccNum = reader.getShortString();
+                std::string_view toAccNum = reader.getShortString();
+                Money amount = Money::fromCents(reader.get<int64_t>());
+                if (!reader.ok() || !reader.atEnd()) break;
+                OperationStatus status = bank.applyTransfer(fromAccNum, toAccNum, amount);
+                mutated = true;
+                respond(out, requestId, toResponseStatus(status));
+                return;
+            }
+            
+            case RequestType::History: {
+                std::string_view accNum = reader.getShortString();
+                uint32_t maxEntries = std::min(reader.get<uint32_t>(), protocolMaxHistoryEntries);
+                if (!reader.ok() || !reader.atEnd()) break;
+                Account* account = bank.findAccount(accNum);
+                if (!account) {
+                    respond(out, requestId, ResponseStatus::AccountNotFound);
+                    return;
+                }
+                BankMetrics* metrics = bank.getMetrics();
+                int64_t start = metrics ? BankMetrics::now() : 0;
+                std::vector<Transaction> history = account->getRecentTransactions(maxEntries);
+                FrameWriter writer(out, requestId, static_cast<uint8_t>(ResponseStatus::Ok));
+                writer.put<uint32_t>(static_cast<uint32_t>(history.size()));
+                for (const Transaction& transaction : history) {
+                    writer.put<uint8_t>(static_cast<uint8_t>(transaction.getType()));
+                    writer.put<int64_t>(transaction.getAmount().getCents());
+                    writer.put<int64_t>(transaction.getBalanceAfter().getCents());
+                    writer.put<int64_t>(transaction.getTimestampNanos());
+                }
+                writer.finish();
+                if (metrics) metrics->recordSince(MetricOperation::History, OperationStatus::Ok, start);
+                return;
+            }
+        }
+        respond(out, requestId, ResponseStatus::BadRequest);
+    }
+    
+    static void respond(std::string& out, uint32_t requestId, ResponseStatus status) {
+        FrameWriter writer(out, requestId, static_cast<uint8_t>(status));
+        writer.finish();
+    }
+    
+    static void respondWithBalance(std::string& out, uint32_t requestId, OperationStatus status, 
+                                   Money balance) {
+        FrameWriter writer(out, requestId, static_cast<uint8_t>(toResponseStatus(status)));
+        if (status == OperationStatus::Ok) {
+            writer.put<int64_t>(balance.getCents());
+        }
+        writer.finish();
+    }
+    
+    void sendResponses(Connection& connection) {
+        while (!connection.broken && connection.outputSent < connection.output.size()) {
+            ssize_t n = ::send(connection.fd, connection.output.data() + connection.outputSent,
+                               connection.output.size() - connection.outputSent, MSG_NOSIGNAL);
+            if (n > 0) {
+                connection.outputSent += size_t(n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) connection.broken = true;
+                break;
+            }
+        }
+        if (connection.outputSent == connection.output.size()) {
+            connection.output.clear();
+            connection.outputSent = 0;
+        } else if (connection.outputSent >= readChunk) {
+            connection.output.erase(0, connection.outputSent);
+            connection.outputSent = 0;
+        }
+    }
+    
+    // Re-registers the connection for the events it now needs: writable
+    // while output is pending, readable unless output has piled up
+    void updateEvents(Connection& connection) {
+        size_t pending = connection.output.size() - connection.outputSent;
+        connection.readPaused = pending > maxPendingOutput;
+        uint32_t wanted = (connection.readPaused || connection.peerClosed ? 0u : uint32_t(EPOLLIN)) | 
+                          (pending > 0 ? uint32_t(EPOLLOUT) : 0u);
+        if (wanted == connection.events) return;
+        epoll_event event{};
+        event.events = wanted;
+        event.data.fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = wanted;
+    }
+    
+    void closeConnection(int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
     }
-};
-
-// Savings Account class - inherits from Account
-class SavingsAccount : public Account {
-private:
-    double interestRate;
-    double minimumBalance;
     
 public:
-    SavingsAccount(const std::string& accNum, const std::string& name, 
-                   double initialBalance = 0.0, double intRate = 0.04, double minBalance = 100.0)
-        : Account(accNum, name, initialBalance), interestRate(intRate), minimumBalance(minBalance) {}
+    explicit BankServer(Bank& b) : bank(b), readBuffer(new char[readChunk]) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+    }
     
-    void deposit(double amount) override {
-        if (amount <= 0) {
-            std::cout << "Invalid deposit amount!" << std::endl;
-            return;
+    ~BankServer() {
+        for (auto& [fd, connection] : connections) {
+            ::close(fd);
         }
-        balance += amount;
-        addTransaction("Deposit", amount);
-        std::cout << "Deposited $" << std::fixed << std::setprecision(2) << amount 
-                  << ". New balance: $" << balance << std::endl;
+        for (int fd : listeners) {
+            ::close(fd);
+        }
+        if (!unixPath.empty()) {
+            ::unlink(unixPath.c_str());
+        }
+        if (signalFd >= 0) ::close(signalFd);
+        if (epollFd >= 0) ::close(epollFd);
     }
     
-    bool withdraw(double amount) override {
-        if (amount <= 0) {
-            std::cout << "Invalid withdrawal amount!" << std::endl;
+    BankServer(const BankServer&) = delete;
+    BankServer& operator=(const BankServer&) = delete;
+    
+    // Replaces any stale socket file left by a previous run
+    bool listenUnix(const std::string& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            error = "socket path too long: " + path;
             return false;
         }
-        
-        if (balance - amount < minimumBalance) {
-            std::cout << "Withdrawal failed! Minimum balance of $" << minimumBalance 
-                      << " must be maintained." << std::endl;
-            return false;
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return fail("socket");
+        ::unlink(path.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return fail("bind " + path);
         }
+        unixPath = path;
+        return addListener(fd);
+    }
+    
+    // Binds 127.0.0.1 only; the protocol has no authentication
+    bool listenTcp(uint16_t port) {
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return fail("socket");
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            ::close(fd);
+            return fail("bind 127.0.0.1:" + std::to_string(port));
+        }
+        return addListener(fd);
+    }
+    
+    const std::string& getError() const { return error; }
+    
+    static sigset_t stopSignals() {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        return signals;
+    }
+    
+    // Must be called before any thread is started (including the log
+    // flusher), so that every thread inherits the blocked mask and the stop
+    // signals reach run() instead of terminating the process
+    static void blockStopSignals() {
+        sigset_t signals = stopSignals();
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    }
+    
+    // Serves requests until SIGINT or SIGTERM arrives
+    bool run() {
+        if (epollFd < 0) return fail("epoll_create1");
+        sigset_t signals = stopSignals();
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (signalFd < 0) return fail("signalfd");
+        epoll_event signalEvent{};
+        signalEvent.events = EPOLLIN;
+        signalEvent.data.fd = signalFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &signalEvent) != 0) return fail("epoll_ctl");
         
-        balance -= amount;
-        addTransaction("Withdrawal", amount);
-        std::cout << "Withdrew $" << std::fixed << std::setprecision(2) << amount 
-                  << ". New balance: $" << balance << std::endl;
+        std::vector<epoll_event> events(256);
+        bool stopping = false;
+        while (!stopping) {
+            int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                return fail("epoll_wait");
+            }
+            
+            for (int i = 0; i < ready; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == signalFd) {
+                    stopping = true;
+                    continue;
+                }
+                if (isListener(fd)) {
+                    acceptConnections(fd);
+                    continue;
+                }
+                auto found = connections.find(fd);
+                if (found == connections.end()) continue;
+                Connection& connection = *found->second;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    readRequests(connection);
+                }
+                if (events[i].events & EPOLLOUT) {
+                    queueFlush(connection);
+                }
+            }
+            
+            // Responses leave only once everything they report is durable
+            if (mutated) {
+                bank.commitJournal();
+                mutated = false;
+            }
+            for (Connection* connection : flushList) {
+                connection->queued = false;
+                sendResponses(*connection);
+                bool drained = connection->output.size() == connection->outputSent;
+                if (connection->broken || (connection->peerClosed && drained)) {
+                    closeConnection(connection->fd);
+                } else {
+                    updateEvents(*connection);
+                }
+            }
+            flushList.clear();
+            
+            if (!bank.checkpointIfDue()) {
+                std::cerr << "Warning: checkpoint failed; "
+                          << "the write-ahead log still holds all changes." << std::endl;
+            }
+        }
         return true;
     }
+};
+
+// Output buffer for script mode: collects result lines and writes them to
+// a file descriptor in large blocks instead of flushing every line
+class ScriptOutput {
+private:
+    static constexpr size_t capacity = 1 << 16;
+    int fd;
+    std::unique_ptr<char[]> buffer;
+    size_t used = 0;
+    bool failed = false;
+    
+public:
+    explicit ScriptOutput(int outFd) : fd(outFd), buffer(new char[capacity]) {}
+    
+    ~ScriptOutput() { flush(); }
+    
+    ScriptOutput(const ScriptOutput&) = delete;
+    ScriptOutput& operator=(const ScriptOutput&) = delete;
+    
+    // Room for one result line: a few short words plus two amounts
+    static constexpr size_t maxLineLength = 128;
+    
+    // Returns space for at most maxLineLength characters
+    char* reserveLine() {
+        if (capacity - used < maxLineLength) flush();
+        return buffer.get() + used;
+    }
     
-    void applyInterest() {
-        double interest = balance * interestRate / 12; // Monthly interest
-        balance += interest;
-        addTransaction("Interest Credit", interest);
-        std::cout << "Interest of $" << std::fixed << std::setprecision(2) << interest 
-                  << " applied. New balance: $" << balance << std::endl;
+    void commitLine(char* end) { used = end - buffer.get(); }
+    
+    void flush() {
+        size_t written = 0;
+        while (written < used && !failed) {
+            ssize_t n = ::write(fd, buffer.get() + written, used - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                failed = true;
+                break;
+            }
+            written += size_t(n);
+        }
+        used = 0;
     }
     
-    void displayAccountInfo() const override {
-        std::cout << "\n=== Savings Account Information ===" << std::endl;
-        std::cout << "Account Number: " << accountNumber << std::endl;
-        std::cout << "Account Holder: " << holderName << std::endl;
-        std::cout << "Account Type: Savings" << std::endl;
-        std::cout << "Current Balance: $" << std::fixed << std::setprecision(2) << balance << std::endl;
-        std::cout << "Interest Rate: " << (interestRate * 100) << "% per annum" << std::endl;
-        std::cout << "Minimum Balance: $" << minimumBalance << std::endl;
+    bool ok() const { return !failed; }
+};
+
+// Keeps a Prometheus metrics file current: rewrites it every interval on a
+// background thread (if the interval is non-zero) and once more when
+// destroyed, so the file always ends up with the final counts
+class MetricsFileWriter {
+private:
+    const BankMetrics& metrics;
+    std::string path;
+    std::chrono::milliseconds interval;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread writer;
+    
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, interval, [this]() { return stopping; })) {
+            lock.unlock();
+            metrics.writePrometheusFile(path);
+            lock.lock();
+        }
     }
     
-    std::string getAccountType() const override {
-        return "Savings";
+public:
+    MetricsFileWriter(const BankMetrics& bankMetrics, const std::string& filePath, 
+                      std::chrono::milliseconds period)
+        : metrics(bankMetrics), path(filePath), interval(period) {
+        if (interval.count() > 0) {
+            writer = std::thread(&MetricsFileWriter::run, this);
+        }
     }
     
-    double getInterestRate() const { return interestRate; }
-    double getMinimumBalance() const { return minimumBalance; }
+    ~MetricsFileWriter() {
+        if (writer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            writer.join();
+        }
+        metrics.writePrometheusFile(path);
+    }
+    
+    MetricsFileWriter(const MetricsFileWriter&) = delete;
+    MetricsFileWriter& operator=(const MetricsFileWriter&) = delete;
 };
 
-// Current Account class - inherits from Account
-class CurrentAccount : public Account {
+// Console application driving a Bank
+class BankingSystem {
 private:
-    double overdraftLimit;
-    double overdraftFee;
+    // Declared before the bank, which records into it
+    BankMetrics metrics;
+    Bank bank;
+    std::string metricsPath;
     
 public:
-    CurrentAccount(const std::string& accNum, const std::string& name, 
-                   double initialBalance = 0.0, double overdraftLim = 1000.0, double overdraftF = 25.0)
-        : Account(accNum, name, initialBalance), overdraftLimit(overdraftLim), overdraftFee(overdraftF) {}
+    BankingSystem() : bank("ABC Bank") {
+        bank.setMetrics(&metrics);
+    }
     
-    void deposit(double amount) override {
-        if (amount <= 0) {
-            std::cout << "Invalid deposit amount!" << std::endl;
-            return;
+    Bank& getBank() { return bank; }
+    BankMetrics& getMetrics() { return metrics; }
+    
+    // Where the metrics menu entry and the M script command write a
+    // Prometheus snapshot; empty disables the file
+    void setMetricsFile(const std::string& path) { metricsPath = path; }
+    
+    void reportTransfer(const std::string& fromAccNum, const std::string& toAccNum, 
+                        Money amount, OperationStatus status) {
+        switch (status) {
+            case OperationStatus::Ok:
+                std::cout << "Transferred $" << amount << " from " << fromAccNum << " to " << toAccNum 
+                          << ". New balances: $" << bank.findAccount(fromAccNum)->getBalance() 
+                          << " / $" << bank.findAccount(toAccNum)->getBalance() << std::endl;
+                break;
+            case OperationStatus::AccountNotFound:
+                std::cout << "Account not found!" << std::endl;
+                break;
+            case OperationStatus::SameAccount:
+                std::cout << "Cannot transfer to the same account!" << std::endl;
+                break;
+            case OperationStatus::InvalidAmount:
+                std::cout << "Invalid transfer amount!" << std::endl;
+                break;
+            case OperationStatus::MinimumBalanceBreach:
+                std::cout << "Transfer failed! Minimum balance must be maintained." << std::endl;
+                break;
+            case OperationStatus::OverdraftLimitExceeded:
+                std::cout << "Transfer failed! Overdraft limit exceeded." << std::endl;
+                break;
+            case OperationStatus::AccountExists:
+                break;
         }
-        balance += amount;
-        addTransaction("Deposit", amount);
-        std::cout << "Deposited $" << std::fixed << std::setprecision(2) << amount 
-                  << ". New balance: $" << balance << std::endl;
     }
     
-    bool withdraw(double amount) override {
-        if (amount <= 0) {
-            std::cout << "Invalid withdrawal amount!" << std::endl;
-            return false;
+    // Splits off the next blank-separated word of a script line
+    static std::string_view nextToken(std::string_view& rest) {
+        size_t begin = 0;
+        while (begin < rest.size() && (rest[begin] == ' ' || rest[begin] == '\t' || rest[begin] == '\r')) {
+            ++begin;
         }
-        
-        if (balance - amount < -overdraftLimit) {
-            std::cout << "Withdrawal failed! Overdraft limit of $" << overdraftLimit 
-                      << " exceeded." << std::endl;
-            return false;
+        size_t end = begin;
+        while (end < rest.size() && rest[end] != ' ' && rest[end] != '\t' && rest[end] != '\r') {
+            ++end;
         }
+        std::string_view token = rest.substr(begin, end - begin);
+        rest.remove_prefix(end);
+        return token;
+    }
+    
+    static std::string_view trim(std::string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+    
+    static char* appendText(char* out, std::string_view text) {
+        std::memcpy(out, text.data(), text.size());
+        return out + text.size();
+    }
+    
+    // Executes one script command and writes its result line:
+    //   S ACC AMOUNT HOLDER NAME   open a savings account     -> OK
+    //   C ACC AMOUNT HOLDER NAME   open a current account     -> OK
+    //   D ACC AMOUNT               deposit                    -> OK BALANCE
+    //   W ACC AMOUNT               withdraw                   -> OK BALANCE
+    //   B ACC                      balance                    -> OK BALANCE
+    //   T FROM TO AMOUNT           transfer                   -> OK
+    //   I                          monthly interest           -> OK ACCOUNTS
+    //   M                          write the metrics file     -> OK
+    // Failures produce "ERR <reason>". Blank lines and lines starting with
+    // '#' produce no output.
+    void executeCommand(std::string_view line, ScriptOutput& out) {
+        std::string_view rest = line;
+        std::string_view command = nextToken(rest);
+        if (command.empty() || command[0] == '#') return;
         
-        balance -= amount;
-        addTransaction("Withdrawal", amount);
+        OperationStatus status = OperationStatus::Ok;
+        const char* error = nullptr;
+        bool hasBalance = false;
+        Money balance;
+        uint64_t count = 0;
+        bool hasCount = false;
         
-        // Apply overdraft fee if balance goes negative
-        if (balance < 0) {
-            balance -= overdraftFee;
-            addTransaction("Overdraft Fee", overdraftFee);
-            std::cout << "Overdraft fee of $" << overdraftFee << " applied." << std::endl;
+        Money amount;
+        char code = command.size() == 1 ? command[0] : '?';
+        switch (code) {
+            case 'D':
+            case 'W': {
+                std::string_view accNum = nextToken(rest);
+                std::string_view amountText = nextToken(rest);
+                if (amountText.empty() || !nextToken(rest).empty()) {
+                    error = "BadCommand";
+                } else if (!Money::parse(amountText, amount)) {
+                    status = OperationStatus::InvalidAmount;
+                } else {
+                    OperationResult result = code == 'D' ? bank.applyDeposit(accNum, amount) 
+                                                         : bank.applyWithdrawal(accNum, amount);
+                    status = result.status;
+                    balance = result.balance;
+                    hasBalance = true;
+                }
+                break;
+            }
+            
+            case 'B': {
+                std::string_view accNum = nextToken(rest);
+                if (accNum.empty() || !nextToken(rest).empty()) {
+                    error = "BadCommand";
+                } else if (Account* acc = bank.findAccount(accNum)) {
+                    balance = acc->getBalance();
+                    hasBalance = true;
+                } else {
+                    status = OperationStatus::AccountNotFound;
+                }
+                break;
+            }
+            
+            case 'T': {
+                std::string_view fromAccNum = nextToken(rest);
+                std::string_view toAccNum = nextToken(rest);
+                std::string_view amountText = nextToken(rest);
+                if (amountText.empty() || !nextToken(rest).empty()) {
+                    error = "BadCommand";
+                } else if (!Money::parse(amountText, amount)) {
+                    status = OperationStatus::InvalidAmount;
+                } else {
+                    status = bank.applyTransfer(fromAccNum, toAccNum, amount);
+                }
+                break;
+            }
+            
+            case 'S':
+            case 'C': {
+                std::string_view accNum = nextToken(rest);
+                std::string_view amountText = nextToken(rest);
+                std::string_view holderName = trim(rest);
+                if (holderName.empty()) {
+                    error = "BadCommand";
+                } else if (!Money::parse(amountText, amount) || amount < Money()) {
+                    status = OperationStatus::InvalidAmount;
+                } else if (code == 'S') {
+                    status = bank.openSavingsAccount(std::string(accNum), std::string(holderName), amount);
+                } else {
+                    status = bank.openCurrentAccount(std::string(accNum), std::string(holderName), amount);
+                }
+                break;
+            }
+            
+            case 'I':
+                if (!nextToken(rest).empty()) {
+                    error = "BadCommand";
+                } else {
+                    count = bank.creditMonthlyInterest();
+                    hasCount = true;
+                }
+                break;
+                
+            case 'M':
+                if (!nextToken(rest).empty()) {
+                    error = "BadCommand";
+                } else if (metricsPath.empty() || !bank.getMetrics()) {
+                    error = "NoMetricsFile";
+                } else if (!bank.getMetrics()->writePrometheusFile(metricsPath)) {
+                    error = "WriteFailed";
+                }
+                break;
+                
+            default:
+                error = "BadCommand";
         }
         
-        std::cout << "Withdrew $" << std::fixed << std::setprecision(2) << amount 
-                  << ". New balance: $" << balance << std::endl;
-        return true;
+        char* p = out.reserveLine();
+        if (error) {
+            p = appendText(p, "ERR ");
+            p = appendText(p, error);
+        } else if (status != OperationStatus::Ok) {
+            p = appendText(p, "ERR ");
+            p = appendText(p, operationStatusName(status));
+        } else {
+            p = appendText(p, "OK");
+            if (hasBalance) {
+                *p++ = ' ';
+                p = balance.format(p);
+            } else if (hasCount) {
+                *p++ = ' ';
+                p = std::to_chars(p, p + 20, count).ptr;
+            }
+        }
+        *p++ = '\n';
+        out.commitLine(p);
     }
     
-    void displayAccountInfo() const override {
-        std::cout << "\n=== Current Account Information ===" << std::endl;
-        std::cout << "Account Number: " << accountNumber << std::endl;
-        std::cout << "Account Holder: " << holderName << std::endl;
-        std::cout << "Account Type: Current" << std::endl;
-        std::cout << "Current Balance: $" << std::fixed << std::setprecision(2) << balance << std::endl;
-        std::cout << "Overdraft Limit: $" << overdraftLimit << std::endl;
-        std::cout << "Overdraft Fee: $" << overdraftFee << std::endl;
-        if (balance < 0) {
-            std::cout << "*** ACCOUNT OVERDRAWN ***" << std::endl;
+    // Non-interactive mode: executes one command per line from inFd (see
+    // executeCommand) and writes one result line per command to outFd, with
+    // no prompts. Input is consumed in large blocks; the results of each
+    // block are written out once the block's operations are durable.
+    // Returns false if reading or writing failed.
+    bool runScript(int inFd, int outFd) {
+        static constexpr size_t blockSize = 1 << 20;
+        std::unique_ptr<char[]> buffer(new char[blockSize]);
+        ScriptOutput out(outFd);
+        size_t pending = 0;   // start of an incomplete line carried over
+        bool readFailed = false;
+        
+        for (;;) {
+            ssize_t n = ::read(inFd, buffer.get() + pending, blockSize - pending);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) readFailed = true;
+            bool atEnd = n <= 0;
+            size_t filled = pending + (n > 0 ? size_t(n) : 0);
+            
+            std::string_view data(buffer.get(), filled);
+            size_t start = 0;
+            for (size_t newline; (newline = data.find('\n', start)) != std::string_view::npos; ) {
+                executeCommand(data.substr(start, newline - start), out);
+                start = newline + 1;
+            }
+            if (atEnd && start < filled) {
+                executeCommand(data.substr(start), out);
+                start = filled;
+            }
+            
+            pending = filled - start;
+            if (pending == blockSize) {
+                // A single line filled the whole block; reject and drop it
+                char* p = appendText(out.reserveLine(), "ERR LineTooLong\n");
+                out.commitLine(p);
+                pending = 0;
+            } else if (pending > 0) {
+                std::memmove(buffer.get(), buffer.get() + start, pending);
+            }
+            
+            bank.commitJournal();
+            out.flush();
+            if (!bank.checkpointIfDue()) {
+                std::cerr << "Warning: checkpoint failed; "
+                          << "the write-ahead log still holds all changes." << std::endl;
+            }
+            if (atEnd) break;
         }
+        
+        if (bank.isPersistent() && !bank.checkpoint()) {
+            std::cerr << "Warning: final checkpoint failed; "
+                      << "the write-ahead log still holds all changes." << std::endl;
+        }
+        return !readFailed && out.ok();
     }
     
-    std::string getAccountType() const override {
-        return "Current";
+    // Presentation of operation results; the bank and its accounts never
+    // print themselves
+    void reportAccountCreation(const std::string& accNum, const char* type, OperationStatus status) {
+        if (status == OperationStatus::AccountExists) {
+            std::cout << "Account number " << accNum << " already exists!" << std::endl;
+            return;
+        }
+        if (status == OperationStatus::InvalidAmount) {
+            std::cout << "Invalid initial deposit amount!" << std::endl;
+            return;
+        }
+        std::cout << type << " account created successfully!" << std::endl;
     }
     
-    double getOverdraftLimit() const { return overdraftLimit; }
-    double getOverdraftFee() const { return overdraftFee; }
-};
-
-// Bank class to manage multiple accounts
-class Bank {
-private:
-    std::vector<std::unique_ptr<Account>> accounts;
-    std::string bankName;
+    void reportDeposit(Money amount, const OperationResult& result) {
+        if (result.status != OperationStatus::Ok) {
+            std::cout << "Invalid deposit amount!" << std::endl;
+            return;
+        }
+        std::cout << "Deposited $" << amount 
+                  << ". New balance: $" << result.balance << std::endl;
+    }
     
-public:
-    Bank(const std::string& name) : bankName(name) {}
+    void reportWithdrawal(const Account& account, Money amount, const OperationResult& result) {
+        switch (result.status) {
+            case OperationStatus::Ok:
+                if (result.fee > Money()) {
+                    std::cout << "Overdraft fee of $" << result.fee << " applied." << std::endl;
+                }
+                std::cout << "Withdrew $" << amount 
+                          << ". New balance: $" << result.balance << std::endl;
+                break;
+            case OperationStatus::InvalidAmount:
+                std::cout << "Invalid withdrawal amount!" << std::endl;
+                break;
+            case OperationStatus::MinimumBalanceBreach:
+                // Only savings accounts have a minimum balance
+                std::cout << "Withdrawal failed! Minimum balance of $" 
+                          << account.getProduct().getMinimumBalance() 
+                          << " must be maintained." << std::endl;
+                break;
+            case OperationStatus::OverdraftLimitExceeded:
+                // Only current accounts have an overdraft
+                std::cout << "Withdrawal failed! Overdraft limit of $" 
+                          << account.getProduct().getOverdraftLimit() 
+                          << " exceeded." << std::endl;
+                break;
+            default:
+                std::cout << "Account not found!" << std::endl;
+        }
+    }
     
-    void createSavingsAccount(const std::string& accNum, const std::string& holderName, 
-                             double initialBalance = 0.0) {
-        accounts.push_back(std::make_unique<SavingsAccount>(accNum, holderName, initialBalance));
-        std::cout << "Savings account created successfully!" << std::endl;
+    void displayAccountInfo(const Account& account) {
+        Money balance = account.getBalance();
+        const ProductDefinition& product = account.getProduct();
+        if (account.getKind() == AccountKind::Savings) {
+            std::cout << "\n=== Savings Account Information ===" << std::endl;
+            std::cout << "Account Number: " << account.getAccountNumber() << std::endl;
+            std::cout << "Account Holder: " << account.getHolderName() << std::endl;
+            std::cout << "Account Type: Savings" << std::endl;
+            std::cout << "Current Balance: $" << balance << std::endl;
+            std::cout << "Interest Rate: " << std::fixed << std::setprecision(2) 
+                      << (product.getInterestRate() * 100) << "% per annum" << std::endl;
+            std::cout << "Minimum Balance: $" << product.getMinimumBalance() << std::endl;
+            return;
+        }
+        std::cout << "\n=== Current Account Information ===" << std::endl;
+        std::cout << "Account Number: " << account.getAccountNumber() << std::endl;
+        std::cout << "Account Holder: " << account.getHolderName() << std::endl;
+        std::cout << "Account Type: Current" << std::endl;
+        std::cout << "Current Balance: $" << balance << std::endl;
+        std::cout << "Overdraft Limit: $" << product.getOverdraftLimit() << std::endl;
+        std::cout << "Overdraft Fee: $" << product.getOverdraftFee() << std::endl;
+        if (balance < Money()) {
+            std::cout << "*** ACCOUNT OVERDRAWN ***" << std::endl;
+        }
     }
     
-    void createCurrentAccount(const std::string& accNum, const std::string& holderName, 
-                             double initialBalance = 0.0) {
-        accounts.push_back(std::make_unique<CurrentAccount>(accNum, holderName, initialBalance));
-        std::cout << "Current account created successfully!" << std::endl;
+    void displayTransactionHistory(const Account& account) {
+        std::cout << "\n=== Transaction History for " << account.getAccountNumber() << " ===" << std::endl;
+        int64_t start = BankMetrics::now();
+        std::vector<Transaction> history = account.getTransactionHistory();
+        if (history.empty()) {
+            std::cout << "No transactions found." << std::endl;
+        } else {
+            for (const auto& transaction : history) {
+                transaction.writeTo(std::cout);
+            }
+            std::cout.flush();
+        }
+        if (bank.getMetrics()) {
+            bank.getMetrics()->recordSince(MetricOperation::History, OperationStatus::Ok, start);
+        }
     }
     
-    Account* findAccount(const std::string& accNum) {
-        auto it = std::find_if(accounts.begin(), accounts.end(),
-            [&accNum](const std::unique_ptr<Account>& acc) {
-                return acc->getAccountNumber() == accNum;
-            });
-        return (it != accounts.end()) ? it->get() : nullptr;
+    void displayMetrics() {
+        std::cout << "\n=== Performance Metrics ===" << std::endl;
+        if (!bank.getMetrics()) {
+            std::cout << "Metrics are disabled." << std::endl;
+            return;
+        }
+        bank.getMetrics()->writePrometheus(std::cout);
+        std::cout.flush();
+        if (!metricsPath.empty()) {
+            if (bank.getMetrics()->writePrometheusFile(metricsPath)) {
+                std::cout << "Metrics written to " << metricsPath << std::endl;
+            } else {
+                std::cout << "Could not write " << metricsPath << std::endl;
+            }
+        }
     }
     
-    void displayAllAccounts() const {
-        std::cout << "\n=== All Accounts in " << bankName << " ===" << std::endl;
-        if (accounts.empty()) {
+    void displayAllAccounts() {
+        std::cout << "\n=== All Accounts in " << bank.getBankName() << " ===" << std::endl;
+        if (bank.getAccountCount() == 0) {
             std::cout << "No accounts found." << std::endl;
             return;
         }
         
-        for (const auto& account : accounts) {
-            std::cout << "Account: " << account->getAccountNumber() 
-                      << " | Holder: " << account->getHolderName()
-                      << " | Type: " << account->getAccountType()
-                      << " | Balance: $" << std::fixed << std::setprecision(2) 
-                      << account->getBalance() << std::endl;
-        }
+        bank.forEachAccount([](const Account& account) {
+            std::cout << "Account: " << account.getAccountNumber() 
+                      << " | Holder: " << account.getHolderName()
+                      << " | Type: " << account.getAccountType()
+                      << " | Balance: $" << account.getBalance() << std::endl;
+        });
     }
     
-    void applyInterestToSavingsAccounts() {
+    void applyMonthlyInterest() {
         std::cout << "\n=== Applying Monthly Interest ===" << std::endl;
-        for (auto& account : accounts) {
-            SavingsAccount* savingsAcc = dynamic_cast<SavingsAccount*>(account.get());
-            if (savingsAcc) {
-                std::cout << "Account " << savingsAcc->getAccountNumber() << ": ";
-                savingsAcc->applyInterest();
-            }
+        for (const InterestCredit& credit : bank.applyMonthlyInterest()) {
+            std::cout << "Account " << credit.account->getAccountNumber() << ": Interest of $" 
+                      << credit.interest << " applied. New balance: $" << credit.balance << std::endl;
         }
     }
     
-    std::string getBankName() const { return bankName; }
-};
-
-// Menu-driven interface
-class BankingSystem {
-private:
-    Bank bank;
-    
-public:
-    BankingSystem() : bank("ABC Bank") {}
+    // Reads an amount token and parses it exactly into cents
+    bool readAmount(Money& amount) {
+        std::string text;
+        std::cin >> text;
+        if (!Money::parse(text, amount)) {
+            std::cout << "Invalid amount!" << std::endl;
+            return false;
+        }
+        return true;
+    }
     
     void displayMenu() {
         std::cout << "\n========== " << bank.getBankName() << " Banking System ==========\n";
@@ -295,18 +939,27 @@ public:
         std::cout << "7. View Transaction History\n";
         std::cout << "8. View All Accounts\n";
         std::cout << "9. Apply Interest to Savings Accounts\n";
-        std::cout << "10. Exit\n";
+        std::cout << "10. Transfer Money\n";
+        std::cout << "11. Export Transactions to CSV\n";
+        std::cout << "12. View Performance Metrics\n";
+        std::cout << "13. Exit\n";
         std::cout << "Enter your choice: ";
     }
     
     void run() {
         int choice;
-        std::string accNum, holderName;
-        double amount;
+        std::string accNum, toAccNum, holderName, path;
+        Money amount;
         
         while (true) {
             displayMenu();
-            std::cin >> choice;
+            if (!(std::cin >> choice)) {
+                // End of input ends the session; anything else is a bad choice
+                if (std::cin.eof()) return;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                choice = 0;
+            }
             
             switch (choice) {
                 case 1:
@@ -316,8 +969,9 @@ public:
                     std::cin.ignore();
                     std::getline(std::cin, holderName);
                     std::cout << "Enter initial deposit (0 for no deposit): ";
-                    std::cin >> amount;
-                    bank.createSavingsAccount(accNum, holderName, amount);
+                    if (!readAmount(amount)) break;
+                    reportAccountCreation(accNum, "Savings", 
+                                          bank.createSavingsAccount(accNum, holderName, amount));
                     break;
                     
                 case 2:
@@ -327,17 +981,18 @@ public:
                     std::cin.ignore();
                     std::getline(std::cin, holderName);
                     std::cout << "Enter initial deposit (0 for no deposit): ";
-                    std::cin >> amount;
-                    bank.createCurrentAccount(accNum, holderName, amount);
+                    if (!readAmount(amount)) break;
+                    reportAccountCreation(accNum, "Current", 
+                                          bank.createCurrentAccount(accNum, holderName, amount));
                     break;
                     
                 case 3:
                     std::cout << "Enter account number: ";
                     std::cin >> accNum;
-                    if (Account* acc = bank.findAccount(accNum)) {
+                    if (bank.findAccount(accNum)) {
                         std::cout << "Enter deposit amount: ";
-                        std::cin >> amount;
-                        acc->deposit(amount);
+                        if (!readAmount(amount)) break;
+                        reportDeposit(amount, bank.deposit(accNum, amount));
                     } else {
                         std::cout << "Account not found!" << std::endl;
                     }
@@ -348,8 +1003,8 @@ public:
                     std::cin >> accNum;
                     if (Account* acc = bank.findAccount(accNum)) {
                         std::cout << "Enter withdrawal amount: ";
-                        std::cin >> amount;
-                        acc->withdraw(amount);
+                        if (!readAmount(amount)) break;
+                        reportWithdrawal(*acc, amount, bank.withdraw(accNum, amount));
                     } else {
                         std::cout << "Account not found!" << std::endl;
                     }
@@ -359,8 +1014,7 @@ public:
                     std::cout << "Enter account number: ";
                     std::cin >> accNum;
                     if (Account* acc = bank.findAccount(accNum)) {
-                        std::cout << "Current balance: $" << std::fixed << std::setprecision(2) 
-                                  << acc->getBalance() << std::endl;
+                        std::cout << "Current balance: $" << acc->getBalance() << std::endl;
                     } else {
                         std::cout << "Account not found!" << std::endl;
                     }
@@ -370,7 +1024,7 @@ public:
                     std::cout << "Enter account number: ";
                     std::cin >> accNum;
                     if (Account* acc = bank.findAccount(accNum)) {
-                        acc->displayAccountInfo();
+                        displayAccountInfo(*acc);
                     } else {
                         std::cout << "Account not found!" << std::endl;
                     }
@@ -380,21 +1034,49 @@ public:
                     std::cout << "Enter account number: ";
                     std::cin >> accNum;
                     if (Account* acc = bank.findAccount(accNum)) {
-                        acc->displayTransactionHistory();
+                        displayTransactionHistory(*acc);
                     } else {
                         std::cout << "Account not found!" << std::endl;
                     }
                     break;
                     
                 case 8:
-                    bank.displayAllAccounts();
+                    displayAllAccounts();
                     break;
                     
                 case 9:
-                    bank.applyInterestToSavingsAccounts();
+                    applyMonthlyInterest();
                     break;
                     
                 case 10:
+                    std::cout << "Enter source account number: ";
+                    std::cin >> accNum;
+                    std::cout << "Enter destination account number: ";
+                    std::cin >> toAccNum;
+                    std::cout << "Enter transfer amount: ";
+                    if (!readAmount(amount)) break;
+                    reportTransfer(accNum, toAccNum, amount, bank.transfer(accNum, toAccNum, amount));
+                    break;
+                    
+                case 11:
+                    std::cout << "Enter output file path: ";
+                    std::cin >> path;
+                    if (bank.exportTransactions(path)) {
+                        std::cout << "Transactions exported to " << path << std::endl;
+                    } else {
+                        std::cout << "Could not write " << path << std::endl;
+                    }
+                    break;
+                    
+                case 12:
+                    displayMetrics();
+                    break;
+                    
+                case 13:
+                    if (bank.isPersistent() && !bank.checkpoint()) {
+                        std::cout << "Warning: final checkpoint failed; "
+                                  << "the write-ahead log still holds all changes." << std::endl;
+                    }
                     std::cout << "Thank you for using " << bank.getBankName() 
                               << " Banking System!" << std::endl;
                     return;
@@ -402,15 +1084,172 @@ public:
                 default:
                     std::cout << "Invalid choice! Please try again." << std::endl;
             }
+            
+            if (!bank.checkpointIfDue()) {
+                std::cout << "Warning: checkpoint failed; "
+                          << "the write-ahead log still holds all changes." << std::endl;
+            }
         }
     }
 };
 
+// Parses a whole command-line value. False for anything else, including
+// a sign on an unsigned option or a number that does not fit T.
+template <typename T>
+static bool parseOptionValue(const char* text, T& value) {
+    const char* end = text + std::strlen(text);
+    auto [parsed, error] = std::from_chars(text, end, value);
+    return error == std::errc() && parsed == end && parsed != text;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--interest-threads N] [--data-dir DIR]"
+              << " [--group-commit RECORDS] [--group-commit-us MICROSECONDS]"
+              << " [--checkpoint-every RECORDS] [--script FILE|-]"
+              << " [--listen-unix PATH] [--listen-tcp PORT]"
+              << " [--activity-log FILE] [--activity-log-policy drop|block]"
+              << " [--metrics-file FILE] [--metrics-interval SECONDS] [--no-metrics]" << std::endl;
+}
+
 // Main function
-int main() {
-    std::cout << "Welcome to the Banking System!\n";
-    
+int main(int argc, char* argv[]) {
     BankingSystem bankingSystem;
+    std::string dataDir;
+    std::string scriptPath;
+    std::string unixSocketPath;
+    int tcpPort = -1;
+    std::string activityLogPath;
+    OverflowPolicy activityLogPolicy = OverflowPolicy::Drop;
+    GroupCommitPolicy commitPolicy;
+    uint64_t checkpointEvery = 100000;
+    std::string metricsPath;
+    double metricsInterval = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool validValue = true;
+        if (arg == "--interest-threads" && i + 1 < argc) {
+            unsigned threads = 0;
+            validValue = parseOptionValue(argv[++i], threads);
+            if (validValue) bankingSystem.getBank().setInterestThreads(threads);
+        } else if (arg == "--data-dir" && i + 1 < argc) {
+            dataDir = argv[++i];
+        } else if (arg == "--checkpoint-every" && i + 1 < argc) {
+            validValue = parseOptionValue(argv[++i], checkpointEvery);
+        } else if (arg == "--group-commit" && i + 1 < argc) {
+            validValue = parseOptionValue(argv[++i], commitPolicy.maxBatch);
+        } else if (arg == "--group-commit-us" && i + 1 < argc) {
+            uint32_t micros = 0;
+            validValue = parseOptionValue(argv[++i], micros);
+            commitPolicy.maxDelay = std::chrono::microseconds(micros);
+        } else if (arg == "--script" && i + 1 < argc) {
+            scriptPath = argv[++i];
+        } else if (arg == "--listen-unix" && i + 1 < argc) {
+            unixSocketPath = argv[++i];
+        } else if (arg == "--listen-tcp" && i + 1 < argc) {
+            uint16_t port = 0;
+            validValue = parseOptionValue(argv[++i], port);
+            tcpPort = port;
+        } else if (arg == "--activity-log" && i + 1 < argc) {
+            activityLogPath = argv[++i];
+        } else if (arg == "--activity-log-policy" && i + 1 < argc &&
+                   (std::string(argv[i + 1]) == "drop" || std::string(argv[i + 1]) == "block")) {
+            activityLogPolicy = std::string(argv[++i]) == "drop" ? OverflowPolicy::Drop 
+                                                                 : OverflowPolicy::Block;
+        } else if (arg == "--metrics-file" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else if (arg == "--metrics-interval" && i + 1 < argc) {
+            validValue = parseOptionValue(argv[++i], metricsInterval) && metricsInterval >= 0;
+        } else if (arg == "--no-metrics") {
+            bankingSystem.getBank().setMetrics(nullptr);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (!validValue) {
+            std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    // Script mode keeps standard output for command results only
+    bool scripted = !scriptPath.empty();
+    bool serving = !unixSocketPath.empty() || tcpPort >= 0;
+    std::ostream& console = scripted ? std::cerr : std::cout;
+    if (!scripted && !serving) {
+        std::cout << "Welcome to the Banking System!\n";
+    }
+    if (serving) {
+        BankServer::blockStopSignals();
+    }
+    // Declared after the bank so it is drained and closed while every
+    // account it may still refer to exists
+    std::unique_ptr<ActivityLogger> activityLog;
+    if (!activityLogPath.empty()) {
+        activityLog = std::make_unique<ActivityLogger>(1 << 16, activityLogPolicy);
+        if (!activityLog->open(activityLogPath)) {
+            std::cerr << "Cannot open activity log " << activityLogPath << std::endl;
+            return 1;
+        }
+        bankingSystem.getBank().setEventSink(activityLog.get());
+    }
+    // Started after the stop signals are blocked, so the writer thread
+    // never receives them
+    std::unique_ptr<MetricsFileWriter> metricsWriter;
+    if (!metricsPath.empty() && bankingSystem.getBank().getMetrics()) {
+        bankingSystem.setMetricsFile(metricsPath);
+        metricsWriter = std::make_unique<MetricsFileWriter>(
+            bankingSystem.getMetrics(), metricsPath, 
+            std::chrono::milliseconds(static_cast<int64_t>(metricsInterval * 1000)));
+    }
+    if (!dataDir.empty()) {
+        Bank& bank = bankingSystem.getBank();
+        RecoveryStats stats = bank.openDataDirectory(dataDir, commitPolicy, checkpointEvery);
+        if (!stats.ok) {
+            std::cerr << "Recovery from " << dataDir << " failed: " << stats.error << std::endl;
+            return 1;
+        }
+        console << "Recovered " << bank.getAccountCount() << " accounts from " << dataDir 
+                  << " in " << std::fixed << std::setprecision(3) << stats.seconds * 1000 << " ms"
+                  << " (snapshot: " << stats.snapshotAccounts << " accounts, " 
+                  << stats.snapshotEntries << " entries; replayed " << stats.replayedRecords 
+                  << " log records)\n";
+    }
+    if (scripted) {
+        int inFd = scriptPath == "-" ? STDIN_FILENO : ::open(scriptPath.c_str(), O_RDONLY);
+        if (inFd < 0) {
+            std::cerr << "Cannot open script " << scriptPath << std::endl;
+            return 1;
+        }
+        bool ok = bankingSystem.runScript(inFd, STDOUT_FILENO);
+        if (inFd != STDIN_FILENO) ::close(inFd);
+        return ok ? 0 : 1;
+    }
+    if (serving) {
+        Bank& bank = bankingSystem.getBank();
+        BankServer server(bank);
+        if ((!unixSocketPath.empty() && !server.listenUnix(unixSocketPath)) ||
+            (tcpPort >= 0 && !server.listenTcp(static_cast<uint16_t>(tcpPort)))) {
+            std::cerr << "Cannot start server: " << server.getError() << std::endl;
+            return 1;
+        }
+        if (!unixSocketPath.empty()) {
+            std::cout << "Listening on " << unixSocketPath << std::endl;
+        }
+        if (tcpPort >= 0) {
+            std::cout << "Listening on 127.0.0.1:" << tcpPort << std::endl;
+        }
+        if (!server.run()) {
+            std::cerr << "Server stopped: " << server.getError() << std::endl;
+            return 1;
+        }
+        if (bank.isPersistent() && !bank.checkpoint()) {
+            std::cerr << "Warning: final checkpoint failed; "
+                      << "the write-ahead log still holds all changes." << std::endl;
+        }
+        std::cout << "Server stopped." << std::endl;
+        return 0;
+    }
     bankingSystem.run();
     
     return 0;